@@ -0,0 +1,35 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Density plots of strange attractors such as the Henon map. Many independent
+ * orbits are iterated in parallel, each worker counting hits into its own
+ * histogram, and the histograms are merged into an Attractor that can be tone
+ * mapped into an Image on a log scale as often as needed.
+ */
+#ifndef ATTRACTOR_H
+
+#define ATTRACTOR_H
+
+#include <stdint.h>
+#include "image.h"
+
+#define ATTRACTOR_ORBIT 1000000 // Points plotted per orbit (one work item)
+#define ATTRACTOR_TRANSIENT 100 // Iterations each orbit runs before plotting
+#define ATTRACTOR_ESCAPE 1e6 // Orbits growing past this are restarted
+
+typedef struct {
+    int rows, cols;
+    double x0, y0, x1, y1; // plotted window, (x0, y0) at the bottom left
+    uint64_t *count; // hits per pixel, rows * cols
+    uint64_t total; // points plotted, including those outside the window
+} Attractor;
+
+Attractor *attractor_create(int rows, int cols, double x0, double y0,
+                            double x1, double y1);
+void attractor_free(Attractor *at);
+void attractor_clear(Attractor *at);
+int attractor_henon(Attractor *at, double a, double b, long long points,
+                    unsigned int seed);
+void attractor_toImage(Attractor *at, Image *im, Color *color);
+
+#endif
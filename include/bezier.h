@@ -9,6 +9,12 @@
 
 #define BEZIER_H
 
+#define BEZIER_MAX_DEPTH 20 // Most subdivisions applied when flattening a curve
+#define BEZIER_TOLERANCE 0.5 // Default flatness tolerance, in pixels
+#define BEZIER_SURFACE_MAX_DEPTH 6 // Finest surface tessellation level
+#define BEZIER_SURFACE_MAX_SEGMENTS (3 << BEZIER_SURFACE_MAX_DEPTH)
+#define BEZIER_CACHE_LIMIT (32 * 1024 * 1024) // Default tessellation cache size, in bytes
+
 typedef struct {
     Point ctrls[4]; // 4 control points for a curve
     int zBuffer;
@@ -18,6 +24,7 @@ typedef struct {
 typedef struct {
     Point ctrls[16]; // 16 control points for a surface
     int zBuffer;
+    int oneSided; // part of a closed surface: back faces need not be drawn
     int subdivisions; // Subdivision cutoff. Used by module_BezierSurface
 } BezierSurface;
 
@@ -28,11 +35,20 @@ void bezierCurve_set(BezierCurve *b, Point *vlist);
 void bezierSurface_set(BezierSurface *b, Point *vlist);
 void bezierCurve_zBuffer(BezierCurve *p, int flag);
 void bezierSurface_zBuffer(BezierCurve *p, int flag);
+void bezierSurface_oneSided(BezierSurface *b, int flag);
 
+int bezierCurve_flatten(BezierCurve *b, int divisions, int safetyFlag, Point *vlist, int maxV);
+int bezierCurve_flattenAdaptive(BezierCurve *b, double tolerance, Point *vlist, int maxV);
 void bezierCurve_draw(BezierCurve *b, Image *src, Color c);
+void bezierCurve_drawAdaptive(BezierCurve *b, double tolerance, Image *src, Color c);
 void bezierCurve_draw_with_subdivisions(BezierCurve *b, int divisions, int safetyFlag, Image *src, Color c);
 
 void bezierCurve_copy(BezierCurve *to, BezierCurve *from);
 void bezierSurface_copy(BezierSurface *to, BezierSurface *from);
 
+Mesh *bezierSurface_tessellate(BezierSurface *b, int divisions, int solid);
+Mesh *bezierSurface_tessellateCached(BezierSurface *b, int divisions, int solid);
+void bezierSurface_setCacheLimit(size_t bytes);
+void bezierSurface_clearCache(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,23 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Deep-zoom Mandelbrot rendering by perturbation. One reference orbit is
+ * computed at the image centre in multi-precision (MPFixed) and every pixel
+ * is iterated as a double-precision offset from it, so views far narrower
+ * than float or double can resolve (down to widths around 1e-200) render at
+ * roughly double-precision speed. Like mandelbrot(), the set is iterated as
+ * z^2 - c.
+ */
+#ifndef DEEPZOOM_H
+
+#define DEEPZOOM_H
+
+#include "mpfixed.h"
+
+#define DEEPZOOM_SA_TOLERANCE 1e-12 // Largest cubic series term, relative to the linear one
+
+Image *image_mandelbrotDeep(const char *cx, const char *cy, double dx, int rows,
+                            int cols, int maxIter);
+int mandelbrot_deep(Image *im, MPFixed *cx, MPFixed *cy, double dx, int maxIter);
+
+#endif
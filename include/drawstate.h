@@ -18,7 +18,8 @@ typedef enum {
     ShadeDepth, // Draw objects using their depth value
     ShadeFlat, // Draw objects using shading calcs, but each polygon is constant
     ShadeGouraud, // Draw using Gouraud shading
-    ShadePhong // Draw using Phong shading
+    ShadePhong, // Draw using Phong shading
+    ShadeDepthOnly // Draw only into the z-buffer, e.g. for shadow maps
 } ShadeMethod;
 
 typedef struct {
@@ -30,6 +31,8 @@ typedef struct {
     int zBufferFlag; // Whether to use the z-buffer hidden surface removal
     Point viewer; // A Point representing the view location in 3D
     float surfaceCoeff;
+    double clipNear; // Smallest homogeneous coordinate drawn (near plane)
+    double clipFar; // Largest homogeneous coordinate drawn (far plane)
 } DrawState;
 
 /* DRAWSTATE FUNCTIONS */
@@ -38,6 +41,7 @@ void drawstate_setColor(DrawState *s, Color c);
 void drawstate_setBody(DrawState *s, Color c);
 void drawstate_setSurface(DrawState *s, Color c);
 void drawstate_setSurfaceCoeff(DrawState *s, float f);
+void drawstate_setClip(DrawState *s, double clipNear, double clipFar);
 void drawstate_copy(DrawState *to, DrawState *from);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Shared machinery for escape-time fractals (Mandelbrot and Julia sets).
+ * The fractals supply a function that computes iteration counts for a batch
+ * of pixels; the engines here decide which pixels need computing.
+ *
+ * Views with square pixels can also be served from a cache of iteration-count
+ * tiles aligned to a grid of that pixel size, so panning only computes the
+ * newly exposed tiles and redrawing a view already seen computes nothing.
+ *
+ * The progressive renderer computes a coarse preview first and refines it in
+ * passes, reporting after each one, and can be abandoned part way through
+ * from another thread with a FractalCancel token.
+ */
+#ifndef FRACTAL_H
+
+#define FRACTAL_H
+
+#include <stdatomic.h>
+#include "image.h"
+
+#define FRACTAL_TILE 64 // Side of the square tiles the subdivision engine starts from
+#define FRACTAL_MIN_RECT 6 // Rectangles this thin are computed pixel by pixel
+#define FRACTAL_COARSE_STEP 8 // Pixel spacing of the first progressive pass
+#define FRACTAL_CANCELLED 1 // Returned by progressive renders that were cancelled
+
+/* Fractals known to the tile cache */
+#define FRACTAL_MANDELBROT 0
+#define FRACTAL_JULIA 1
+
+/* Enum naming the different rendering engines */
+typedef enum {
+    EngineBrute, // Iterate every pixel
+    EngineSubdivide // Mariani-Silver: fill rectangles whose border is uniform
+} FractalEngine;
+
+/* Compute the iteration counts of the n pixels (row[k], col[k]) into
+   counts[k]. worker is the parallel_for() worker making the call and n is at
+   most FRACTAL_TILE * FRACTAL_TILE. */
+typedef void (*FractalBatch)(const int *row, const int *col, int n, int worker,
+                             int *counts, void *arg);
+
+/* Called after each progressive pass with the pixel spacing of the pass just
+   finished (1 for the last). Pixels not computed yet show the nearest sample
+   above and to their left, so im is always a complete preview. */
+typedef void (*FractalProgress)(Image *im, int step, void *arg);
+
+/* Called by fractal_progressive() after each pass with counts fully filled. */
+typedef void (*FractalPass)(int step, void *arg);
+
+/* Everything apart from position and zoom that determines a fractal's
+   iteration counts. Identifies the fractal in the tile cache. */
+typedef struct {
+    int fractal; // FRACTAL_MANDELBROT or FRACTAL_JULIA
+    int maxIter; // iteration limit
+    double a, b; // fractal-specific parameters, e.g. the Julia constant
+} FractalParams;
+
+/* Cancellation token for progressive renders. */
+typedef struct {
+    atomic_int cancelled; // set once by fractal_cancel()
+} FractalCancel;
+
+void fractal_setEngine(FractalEngine engine);
+FractalEngine fractal_engine(void);
+int fractal_subdivide(int rows, int cols, int *counts, FractalBatch batch,
+                      void *arg);
+void fractal_cancelInit(FractalCancel *token);
+void fractal_cancel(FractalCancel *token);
+int fractal_cancelled(FractalCancel *token);
+int fractal_cached(int rows, int cols, int row0, int col0, double pixel,
+                   FractalParams *params, int *counts, FractalBatch batch,
+                   void *arg);
+void fractal_setCacheLimit(size_t bytes);
+size_t fractal_cacheLimit(void);
+void fractal_clearCache(void);
+int fractal_progressive(int rows, int cols, int *counts, FractalBatch batch,
+                        FractalPass pass, void *arg, FractalCancel *cancel);
+
+#endif
@@ -61,6 +61,7 @@ void line_zBuffer(Line *l, int flag);
 void line_normalize(Line *l);
 void line_copy(Line *to, Line *from);
 void line_draw(Line *l, Image *src, Color c);
+void line_drawStrip(Point *vlist, int numV, int zBuffer, Image *src, Color c);
 
 /* CIRCLE PRIMITIVES */
 void circle_set(Circle *c, Point tc, double tr);
@@ -69,6 +70,7 @@ void circle_drawFill(Circle *c, Image *src, Color p);
 
 /* ELLIPSE PRIMITIVES */
 void ellipse_set(Ellipse *e, Point tc, double ta, double tb);
+void ellipse_setAngle(Ellipse *e, double ta);
 void ellipse_draw(Ellipse *e, Image *src, Color p);
 void ellipse_drawFill(Ellipse *e, Image *src, Color p);
 
@@ -8,9 +8,14 @@
 #include "list.h"
 #include "color.h"
 #include "fpixel.h"
+#include "parallel.h"
+#include "fractal.h"
 #include "image.h"
+#include "palette.h"
 #include "mandelbrot.h"
+#include "deepzoom.h"
 #include "julia.h"
+#include "attractor.h"
 #include "horizontalSin.h"
 #include "graphics.h"
 #include "drawstate.h"
@@ -18,6 +23,7 @@
 #include "matrix.h"
 #include "views.h"
 #include "lighting.h"
+#include "mesh.h"
 #include "bezier.h"
 #include "modeling.h"
 
@@ -3,6 +3,14 @@
 #define IMAGE_H
 #include "graphicslib.h"
 
+/* The reflectance of a surface drawn into an Image's G-buffer */
+typedef struct {
+    Color body; // body reflection color
+    Color surface; // surface reflection color
+    float sharpness; // surface reflection coefficient
+    int oneSided; // only the front of the surface is lit
+} Material;
+
 typedef struct {
     FPixel *data;
     int rows; // num rows in the image
@@ -10,6 +18,14 @@ typedef struct {
     float *depth; // z-values (depth) for each pixel
     float *alpha; // alpha (transparency) for each pixel
     float maxval; // maximum value a pixel can have
+
+    /* G-buffer for deferred (Phong) shading, NULL until image_allocGBuffer().
+    Together with depth it records the visible surface at each pixel */
+    float *normal; // interpolated surface normal, 3 floats per pixel
+    int *material; // index into materials, -1 where nothing was drawn
+    Material *materials; // the materials drawn since the G-buffer was cleared
+    int nMaterials;
+    int maxMaterials;
 } Image;
 
 
@@ -19,6 +35,10 @@ void image_free(Image *src);
 void image_init(Image *src);
 int image_alloc(Image *src, int rows, int cols);
 void image_dealloc(Image *src);
+int image_allocGBuffer(Image *src);
+void image_clearGBuffer(Image *src);
+int image_material(Image *src, Color *body, Color *surface, float sharpness,
+                   int oneSided);
 
 /* I/O Functions */
 Image *image_read(char *filename);
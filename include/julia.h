@@ -2,9 +2,28 @@
 
 #define JULIA_H
 #include "image.h"
+#include "fractal.h"
+#include "palette.h"
 #include <math.h>
 
+#define JULIA_FRAMES_IN_FLIGHT 8 // Frames an animation renders at once
+
+/* Receives each finished frame of a Julia animation, in order. The frame is
+   reused once the sink returns. */
+typedef void (*JuliaFrameSink)(Image *frame, int index, void *arg);
+
 Image *image_julia(float x0, float y0, float x1, float y1, int rows);
 void julia(Image *im, float x0, float y0, float dx);
+int julia_iterations(IterBuffer *b, float x0, float y0, float dx);
+int julia_animate(int nFrames, const double *cx, const double *cy, int rows,
+                  int cols, float x0, float y0, float dx, JuliaFrameSink sink,
+                  void *arg);
+void julia_frameWriter(Image *frame, int index, void *pattern);
+Image *image_juliaProgressive(float x0, float y0, float x1, float y1, int rows,
+                              FractalProgress progress, void *arg,
+                              FractalCancel *cancel);
+int julia_progressive(Image *im, float x0, float y0, float dx,
+                      FractalProgress progress, void *arg,
+                      FractalCancel *cancel);
 
 #endif
\ No newline at end of file
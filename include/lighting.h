@@ -1,9 +1,118 @@
 /**
  * David J Anderson - November 2021
- * 
+ *
  * Defines data structures and headers for representing lighting in a scene.
- * UNIMPLEMENTED as of 11/2/2021.
+ *
+ * A Lighting holds any number of ambient lights (summed into one color) and
+ * up to MAX_LIGHTS directional and point lights. Lights are not kept as a
+ * list of structs: each type is packed into parallel float arrays, one per
+ * coordinate and color channel, so shading a batch of vertices is a handful
+ * of straight loops over arrays per light rather than a function call and a
+ * switch per vertex per light.
+ *
+ * Directional and point lights can cast shadows through a ShadowMap: a depth
+ * image of the scene drawn from the light with module_drawShadowMap(). A
+ * surface point is lit by the light only if nothing in the map is nearer the
+ * light along its line of sight.
+ */
+#ifndef LIGHTING_H
+
+#define LIGHTING_H
+
+#include "graphicslib.h"
+
+#define MAX_LIGHTS 64 // most directional (or point) lights in a Lighting
+#define SHADE_BATCH 64 // vertices shaded per lighting_shadeBatch() call
+
+struct ViewPipeline; // views.h, which may be read after this header
+
+/**
+ * The depth of the scene as seen from a light, drawn with ShadeDepthOnly
+ * through a perspective view placed at the light (directional lights need a
+ * distant view looking along their direction). The map is in world
+ * coordinates, so a light placed inside a module shares it with the world
+ * position it ends up at.
+ */
+typedef struct {
+    Matrix vtm; // the light's view: world -> homogeneous map coordinates
+    double clipNear; // clip range of the view's homogeneous coordinate
+    double clipFar;
+    Image *depth; // 1/z of the nearest surface at each pixel, 0 where none
+    float bias; // how far, as a fraction of its depth, a point may lie
+                // behind the map's surface and still count as lit
+} ShadowMap;
+
+typedef enum {
+    LightNone,
+    LightAmbient, // lights every surface equally
+    LightDirect, // parallel light travelling along a direction
+    LightPoint // light radiating from a position
+} LightType;
+
+/* One light, as passed to lighting_add() and stored by module_light() */
+typedef struct {
+    LightType type;
+    Color color;
+    Vector direction; // direction the light travels (LightDirect)
+    Point position; // location of the light (LightPoint)
+    ShadowMap *shadow; // shadows cast by the light, NULL for none
+} Light;
+
+typedef struct {
+    Color ambient; // sum of the ambient lights
+
+    /* Directional lights: unit vector pointing back towards the light, and
+    its color */
+    int nDirect;
+    float directX[MAX_LIGHTS], directY[MAX_LIGHTS], directZ[MAX_LIGHTS];
+    float directR[MAX_LIGHTS], directG[MAX_LIGHTS], directB[MAX_LIGHTS];
+    ShadowMap *directShadow[MAX_LIGHTS];
+
+    /* Point lights: position and color */
+    int nPoint;
+    float pointX[MAX_LIGHTS], pointY[MAX_LIGHTS], pointZ[MAX_LIGHTS];
+    float pointR[MAX_LIGHTS], pointG[MAX_LIGHTS], pointB[MAX_LIGHTS];
+    ShadowMap *pointShadow[MAX_LIGHTS];
+} Lighting;
+
+/**
+ * Up to SHADE_BATCH vertices to be shaded together, stored the same way as
+ * the lights. The caller fills in n, the world positions, and the unit
+ * normals; lighting_shadeBatch() fills in the colors.
  */
 typedef struct {
-    ;
-} Lighting;
\ No newline at end of file
+    int n; // number of vertices in the batch
+    float x[SHADE_BATCH], y[SHADE_BATCH], z[SHADE_BATCH];
+    float nx[SHADE_BATCH], ny[SHADE_BATCH], nz[SHADE_BATCH];
+    float r[SHADE_BATCH], g[SHADE_BATCH], b[SHADE_BATCH];
+} ShadeBatch;
+
+/* LIGHTING FUNCTIONS */
+Lighting *lighting_create(void);
+void lighting_init(Lighting *l);
+void lighting_free(Lighting *l);
+void lighting_clear(Lighting *l);
+void lighting_add(Lighting *l, Light *light);
+void lighting_shadeBatch(Lighting *l, ShadeBatch *batch, Point *viewer,
+                         Color *body, Color *surface, float sharpness,
+                         int oneSided);
+void lighting_shading(Lighting *l, Vector *N, Point *p, Point *viewer,
+                      Color *body, Color *surface, float sharpness,
+                      int oneSided, Color *c);
+void lighting_shadeVertices(Lighting *l, int n, Point *vertex, Vector *normal,
+                            DrawState *ds, int oneSided, Color *color);
+void lighting_shadePolygon(Lighting *l, Polygon *p, DrawState *ds);
+void lighting_shadeGBuffer(Lighting *l, Image *src, Matrix *VTM,
+                           Point *viewer);
+
+/* LIGHT FUNCTIONS */
+void light_set(Light *light, LightType type, Color *c, Vector *direction,
+               Point *position);
+void light_xform(Matrix *m, Light *light);
+void light_setShadow(Light *light, ShadowMap *shadow);
+
+/* SHADOW MAP FUNCTIONS */
+ShadowMap *shadowmap_create(struct ViewPipeline *view);
+void shadowmap_free(ShadowMap *sm);
+
+#endif
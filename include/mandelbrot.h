@@ -2,8 +2,25 @@
 
 #define MANDELBROT_H
 #include "image.h"
+#include "fractal.h"
+#include "palette.h"
+
+/* Shortcuts for points inside the set, for mandelbrot_setShortcuts() */
+#define MANDELBROT_INTERIOR 1 // closed-form main cardioid / period-2 bulb test
+#define MANDELBROT_PERIODICITY 2 // stop when an orbit repeats exactly
 
 Image *image_mandelbrot(float x0, float y0, float x1, float y1, int rows);
 void mandelbrot(Image *im, float x0, float y0, float dx);
+Image *image_mandelbrotProgressive(float x0, float y0, float x1, float y1,
+                                   int rows, FractalProgress progress,
+                                   void *arg, FractalCancel *cancel);
+int mandelbrot_progressive(Image *im, float x0, float y0, float dx,
+                           FractalProgress progress, void *arg,
+                           FractalCancel *cancel);
+int mandelbrot_iterations(IterBuffer *b, float x0, float y0, float dx);
+void mandelbrot_setShortcuts(int flags);
+int mandelbrot_escape(float cx, float cy, int maxIter);
+void mandelbrot_escapeRow(const float *cx, const float *cy, int n, int maxIter,
+                          int *counts);
 
 #endif
\ No newline at end of file
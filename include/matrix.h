@@ -22,10 +22,12 @@ double matrix_get(Matrix *m, int r, int c);
 void matrix_set(Matrix *m, int r, int c, double v);
 void matrix_copy(Matrix *dest, Matrix *src);
 void matrix_transpose(Matrix *m);
+int matrix_inverseTranspose(Matrix *m, Matrix *n);
 void matrix_multiply(Matrix *left, Matrix *right, Matrix *m);
 void matrix_xformPoint(Matrix *m, Point *p, Point *q);
 void matrix_xformVector(Matrix *m, Vector *p, Vector *q);
 void matrix_xformPolygon(Matrix *m, Polygon *p);
+void matrix_xformPolygonNormal(Matrix *m, Matrix *normal, Polygon *p);
 void matrix_xformPolyline(Matrix *m, Polyline *p);
 void matrix_xformLine(Matrix *m, Line *line);
 void matrix_scale2D(Matrix *m, double sx, double sy);
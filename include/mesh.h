@@ -0,0 +1,41 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Defines an indexed triangle mesh, used to hold tessellated surfaces such as
+ * Bezier patches. Vertices are stored once and shared between the triangles
+ * (or edges) that reference them, so each vertex is only transformed once per
+ * draw.
+ *
+ * Meshes are reference counted so that one tessellation can be shared between
+ * modules (and the Bezier tessellation cache). A shared Mesh must be treated
+ * as immutable.
+ */
+#ifndef MESH_H
+
+#define MESH_H
+
+#include "graphicslib.h"
+
+typedef struct {
+    int nVertex; // number of shared vertices
+    Point *vertex; // vertex positions
+    Vector *normal; // per-vertex surface normals
+    int nTriangle; // number of triangles
+    int *triangle; // 3 vertex indices per triangle
+    int nEdge; // number of edges
+    int *edge; // 2 vertex indices per edge
+    int solid; // fill the triangles (1) or draw only the edges (0)
+    int oneSided; // triangles wound counter-clockwise from outside a closed
+                  // surface, so those facing away are skipped (solid only)
+    int zBuffer; // Whether to use the z-buffer - should default to true (1)
+    int refCount; // number of owners; the Mesh is freed when this reaches 0
+} Mesh;
+
+Mesh *mesh_create(int nVertex, int nTriangle, int nEdge);
+Mesh *mesh_retain(Mesh *m);
+void mesh_free(Mesh *m);
+size_t mesh_size(Mesh *m);
+int mesh_draw(Mesh *m, Matrix *VTM, Matrix *world, DrawState *ds,
+              Lighting *lighting, Image *src);
+
+#endif
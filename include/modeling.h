@@ -26,7 +26,8 @@ typedef enum { // enum of different types of objects that can be in modules
     ObjSurfaceCoeff,
     ObjLight,
     ObjModule,
-    ObjBezier
+    ObjBezier,
+    ObjMesh
 } ObjectType;
 
 /* Union defining possible contents of Element objects */
@@ -40,6 +41,8 @@ typedef union {
     float coeff;
     BezierCurve curve;
     void *module;
+    Mesh *mesh;
+    Light light;
 } Object;
 
 // Module structure
@@ -54,8 +57,25 @@ typedef struct {
 typedef struct {
     Element *head; // pointer to the head of the linked list
     Element *tail; // keep around a pointer to the last object
+
+    /* Bounding box of the Module's contents in its own coordinates, cached by
+    module_bounds() until the Module or one of its submodules is changed */
+    unsigned long changed; // stamp of the Module's last change
+    Point boundsMin;
+    Point boundsMax;
+    unsigned long boundsStamp; // newest stamp in the subtree the box reflects
 } Module;
 
+/* Counts of the work module_draw() skipped, accumulated over every call
+until module_resetStats() */
+typedef struct {
+    long polygons; // polygons module_draw() was asked to draw
+    long backFaces; // one-sided polygons and mesh triangles skipped as
+                    // facing away
+    long clipped; // polygons entirely outside the view volume
+    long modules; // modules skipped because their bounds were out of view
+} ModuleStats;
+
 /* 2D AND GENERIC MODULE FUNCTIONS */
 Element *element_create(void);
 Element *element_init(ObjectType type, void *obj);
@@ -75,7 +95,16 @@ void module_translate2D(Module *md, double tx, double ty);
 void module_scale2D(Module *md, double sx, double sy);
 void module_rotateZ(Module *md, double cth, double sth);
 void module_shear2D(Module *md, double shx, double shy);
+int module_bounds(Module *md, Point *min, Point *max);
+struct ViewPipeline; // views.h, which may be read after this header
+void module_resetStats(void);
+void module_stats(ModuleStats *stats);
+void module_lighting(Module *md, Matrix *GTM, Lighting *lighting);
 void module_draw(Module *md, Matrix *VTM, Matrix *GTM, DrawState *ds, Lighting *lighting, Image *src);
+void module_drawMultiView(Module *md, Matrix *GTM, DrawState *ds,
+                          Lighting *lighting, struct ViewPipeline *views,
+                          Image **images, int nViews);
+void module_drawShadowMap(Module *md, Matrix *GTM, ShadowMap *sm);
 
 /* 3D MODULE FUNCTIONS */
 void module_translate(Module *md, double tx, double ty, double tz);
@@ -88,6 +117,7 @@ void module_cube(Module *md, int solid);
 /* BEZIER CURVE AND SURFACE FUNCTIONS */
 void module_bezierCurve(Module *m, BezierCurve *b, int divisions);
 void module_bezierSurface(Module *m, BezierSurface *b, int divisions, int solid);
+void module_mesh(Module *md, Mesh *mesh);
 void module_cylinder(Module *md, int sides);
 void module_cone(Module *md, int sides);
 void module_tetrahedron(Module *md);
@@ -99,4 +129,5 @@ void module_color(Module *md, Color *c);
 void module_bodyColor(Module  *md, Color *c);
 void module_surfaceColor(Module *md, Color *c);
 void module_surfaceCoeff(Module *md, float coeff);
+void module_light(Module *md, Light *light);
 #endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * A small software multi-precision fixed-point number, used where double
+ * precision runs out, such as the reference orbit of a deep fractal zoom.
+ * Numbers are sign-magnitude with one 32-bit integer limb followed by up to
+ * MP_LIMBS - 1 fractional limbs, most significant first, so they hold values
+ * below 2^32 in magnitude to about 32 * (limbs - 1) bits after the point.
+ */
+#ifndef MPFIXED_H
+
+#define MPFIXED_H
+
+#include <stdint.h>
+
+#define MP_LIMBS 24 // Most limbs an MPFixed can use (about 700 fractional bits)
+
+typedef struct {
+    int sign; // 1 or -1
+    int limbs; // limbs in use, between 2 and MP_LIMBS
+    uint32_t limb[MP_LIMBS]; // limb[0] is the integer part
+} MPFixed;
+
+void mp_set(MPFixed *a, double v, int limbs);
+int mp_setString(MPFixed *a, const char *s, int limbs);
+int mp_limbsFor(double resolution);
+double mp_toDouble(MPFixed *a);
+void mp_add(MPFixed *a, MPFixed *b, MPFixed *r);
+void mp_sub(MPFixed *a, MPFixed *b, MPFixed *r);
+void mp_mul(MPFixed *a, MPFixed *b, MPFixed *r);
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Separates computing an escape-time fractal from coloring it. Iteration
+ * counts are kept in a compact IterBuffer (16 bits per pixel when they fit,
+ * otherwise 32), and a Palette maps counts to colors through a precomputed
+ * lookup table, so an image can be recolored without iterating again.
+ *
+ * A smooth IterBuffer holds continuous counts in 24.8 fixed point, with the
+ * fraction taken from how far past the escape radius the orbit landed; the
+ * palette then blends neighbouring entries instead of banding.
+ */
+#ifndef PALETTE_H
+
+#define PALETTE_H
+
+#include <stdint.h>
+#include "image.h"
+
+#define PALETTE_FRAC_BITS 8 // Fractional bits of a smooth count
+#define PALETTE_FRAC_ONE (1 << PALETTE_FRAC_BITS)
+
+typedef struct {
+    int rows, cols;
+    int maxIter; // counts lie in [0, maxIter)
+    int smooth; // counts carry PALETTE_FRAC_BITS of fraction (always 32-bit)
+    uint16_t *u16; // rows * cols counts when 16 bits suffice, else NULL
+    uint32_t *u32; // rows * cols counts otherwise, else NULL
+} IterBuffer;
+
+typedef struct {
+    int size; // number of entries; larger counts use the last one
+    FPixel *lut; // color of each count
+} Palette;
+
+IterBuffer *iterbuffer_create(int rows, int cols, int maxIter, int smooth);
+void iterbuffer_free(IterBuffer *b);
+void iterbuffer_setRow(IterBuffer *b, int i, const int *counts,
+                       const float *frac);
+float iterbuffer_smooth(float zx, float zy);
+
+Palette *palette_create(int size);
+void palette_free(Palette *p);
+Palette *palette_createLog(int maxIter, int channel);
+Palette *palette_createGradient(int size, Color *stops, int nStops);
+void palette_apply(Palette *p, IterBuffer *b, Image *im);
+
+#endif
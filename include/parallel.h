@@ -0,0 +1,25 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * A small work-sharing driver for embarrassingly parallel loops such as
+ * rendering the rows of a fractal. Work items are handed out one at a time
+ * from an atomic counter, so threads that draw cheap items simply take more
+ * of them and no core sits idle behind an expensive band of the image. The
+ * worker threads persist between loops, so even short loops run once or more
+ * per frame are cheap to start.
+ */
+#ifndef PARALLEL_H
+
+#define PARALLEL_H
+
+#define PARALLEL_MAX_THREADS 256 // Upper bound on the number of workers
+
+/* A unit of work. index is the work item in [0, count) and worker identifies
+   the calling thread in [0, parallel_threads()), for per-thread scratch space. */
+typedef void (*ParallelTask)(int index, int worker, void *arg);
+
+int parallel_threads(void);
+void parallel_setThreads(int n);
+void parallel_for(int count, ParallelTask task, void *arg);
+
+#endif
@@ -25,8 +25,9 @@
  * *vertex) connects to the first.
  */
 typedef struct {
-    /* Whether to convert the polygon to one sided (1) or two-sided (0) for
-       shading */
+    /* Whether the polygon is one-sided (1) or two-sided (0). One-sided
+       polygons are wound counter-clockwise around their front and are not
+       drawn from behind. Defaults to two-sided */
     int oneSided;
     int nVertex; // number of vertices
     Point *vertex; // vertex information/list
@@ -35,6 +36,29 @@ typedef struct {
     int zBuffer; // Whether to use the z-buffer - should default to true (1)
 } Polygon;
 
+/* Outcode bits, one per plane of the clip volume */
+#define CLIP_LEFT 0x01 // x < 0
+#define CLIP_RIGHT 0x02 // x > cols
+#define CLIP_TOP 0x04 // y < 0
+#define CLIP_BOTTOM 0x08 // y > rows
+#define CLIP_NEAR 0x10 // in front of the near plane
+#define CLIP_FAR 0x20 // behind the far plane
+#define CLIP_ALL 0x3f
+
+/**
+ * The view volume in homogeneous screen coordinates, i.e. after the VTM but
+ * before normalization. A point (x, y, z, h) is inside when 0 <= x <= cols*h,
+ * 0 <= y <= rows*h and hNear <= h <= hFar. Only the planes set in <planes>
+ * are tested.
+ */
+typedef struct {
+    double cols; // image width
+    double rows; // image height
+    double hNear; // smallest homogeneous coordinate kept
+    double hFar; // largest homogeneous coordinate kept
+    int planes; // CLIP_* bits of the planes to clip against
+} ClipVolume;
+
 Polygon *polygon_create(void);
 Polygon *polygon_createp(int numV, Point *vlist);
 void polygon_free(Polygon *p);
@@ -45,6 +69,12 @@ void polygon_setSided(Polygon *p, int oneSided);
 void polygon_copy(Polygon *to, Polygon *from);
 void polygon_print(Polygon *p, FILE *fp);
 void polygon_normalize(Polygon *p);
+void polygon_faceNormal(Polygon *p, Vector *n);
+void polygon_setFaceNormals(Polygon *p);
+int polygon_backFacing(Polygon *p);
+void clipvolume_set(ClipVolume *cv, Image *src, DrawState *ds);
+int point_outcode(Point *pt, ClipVolume *cv);
+int polygon_clip(Polygon *p, ClipVolume *cv);
 void polygon_draw(Polygon *p, Image *src, Color c);
 void polygon_drawFill(Polygon *p, Image *src, Color c, DrawState* ds);
 void polygon_drawFill_SuperSampled(Polygon *p, Image *src, Color c, DrawState* ds);
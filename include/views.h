@@ -44,9 +44,27 @@ typedef struct {
 
 } View3D;
 
+/**
+ * A View3D together with everything derived from it that drawing needs, so
+ * scenes drawn from the same cameras repeatedly only build these once: the
+ * VTM (which includes the mapping to the screen), the clip range of the
+ * homogeneous coordinate, and the six planes of the view frustum in world
+ * coordinates.
+ */
+typedef struct ViewPipeline {
+    View3D view; // the view the pipeline was built from
+    Matrix vtm; // world -> homogeneous screen coordinates
+    double clipNear; // homogeneous coordinate of the front clip plane
+    double clipFar; // homogeneous coordinate of the back clip plane
+    double plane[6][4]; // frustum planes (a, b, c, d); ax+by+cz+d >= 0 inside
+} ViewPipeline;
+
 void view2D_set(View2D *view, Point *vrp, float dx, Vector *xaxis, int screenx,\
                 int screeny);
 void matrix_setView2D(Matrix *vtm, View2D *view);
 void matrix_setView3D(Matrix *vtm, View3D *view);
 void matrix_setViewParallel(Matrix *vtm, View3D *view);
+void view3D_setClip(View3D *view, DrawState *ds);
+void viewpipeline_set(ViewPipeline *vp, View3D *view);
+int viewpipeline_visible(ViewPipeline *vp, Point *min, Point *max);
 #endif
\ No newline at end of file
@@ -0,0 +1,231 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Implements attractor.h. Each work item of parallel_for() is one orbit of up
+ * to ATTRACTOR_ORBIT points from its own pseudo-random start, so the result
+ * only depends on the seed, not on the number of threads.
+ */
+#include <string.h>
+#include "graphicslib.h"
+
+/**
+ * Allocate an Attractor for a rows x cols plot of the window with bottom left
+ * (x0, y0) and top right (x1, y1), with every count at 0.
+ */
+Attractor *attractor_create(int rows, int cols, double x0, double y0,
+                            double x1, double y1) {
+    Attractor *at;
+
+    if (rows <= 0 || cols <= 0 || x1 <= x0 || y1 <= y0) {
+        printf("attractor_create(): invalid size or window.\n");
+        return NULL;
+    }
+
+    at = malloc(sizeof(Attractor));
+    if (!at) {
+        printf("attractor_create(): malloc() failed.\n");
+        return NULL;
+    }
+    at->rows = rows;
+    at->cols = cols;
+    at->x0 = x0;
+    at->y0 = y0;
+    at->x1 = x1;
+    at->y1 = y1;
+    at->total = 0;
+    at->count = calloc((size_t) rows * cols, sizeof(uint64_t));
+    if (!at->count) {
+        printf("attractor_create(): malloc() failed.\n");
+        free(at);
+        return NULL;
+    }
+
+    return at;
+}
+
+void attractor_free(Attractor *at) {
+    if (!at) {
+        printf("attractor_free(): passed NULL pointer.\n");
+        return;
+    }
+
+    free(at->count);
+    free(at);
+}
+
+/**
+ * Reset every count to 0.
+ */
+void attractor_clear(Attractor *at) {
+    if (!at) {
+        printf("attractor_clear(): passed NULL pointer.\n");
+        return;
+    }
+
+    memset(at->count, 0, sizeof(uint64_t) * at->rows * at->cols);
+    at->total = 0;
+}
+
+typedef struct {
+    Attractor *at;
+    double a, b;
+    long long points; // total to plot
+    unsigned int seed;
+    uint32_t *hist; // per-worker histograms, rows * cols each
+} HenonJob;
+
+/**
+ * xorshift32 step, returning a double in [-0.5, 0.5).
+ */
+static double attractor_random(uint32_t *state) {
+    uint32_t s = *state;
+
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    *state = s;
+    return s * (1.0 / 4294967296.0) - 0.5;
+}
+
+/**
+ * Plot orbit index of the Henon map (x, y) -> (y - a x^2 + 1, b x) into the
+ * worker's histogram, restarting from a new random point if it diverges.
+ */
+static void attractor_henonOrbit(int index, int worker, void *arg) {
+    HenonJob *job = arg;
+    Attractor *at = job->at;
+    uint32_t *hist = job->hist + (size_t) worker * at->rows * at->cols;
+    long long first = (long long) index * ATTRACTOR_ORBIT;
+    long long n = job->points - first < ATTRACTOR_ORBIT ?
+                  job->points - first : ATTRACTOR_ORBIT;
+    double sx = at->cols / (at->x1 - at->x0), sy = at->rows / (at->y1 - at->y0);
+    double a = job->a, b = job->b, x, y, t;
+    uint32_t state = (job->seed ^ (uint32_t) index * 2654435761u) | 1;
+
+    while (n > 0) {
+        // Start, or restart after diverging, from a random point
+        x = attractor_random(&state);
+        y = attractor_random(&state);
+        for (int k = 0; k < ATTRACTOR_TRANSIENT; k++) {
+            t = y - a * x * x + 1;
+            y = b * x;
+            x = t;
+        }
+
+        for (; n > 0; n--) {
+            t = y - a * x * x + 1;
+            y = b * x;
+            x = t;
+
+            if (!(fabs(x) < ATTRACTOR_ESCAPE)) {
+                n--; // the diverged point still counts, so this terminates
+                break;
+            }
+
+            // Row 0 is the top of the window
+            double c = (x - at->x0) * sx, r = (at->y1 - y) * sy;
+            if (c >= 0 && c < at->cols && r >= 0 && r < at->rows) {
+                hist[(int) r * at->cols + (int) c]++;
+            }
+        }
+    }
+}
+
+static void attractor_mergeRow(int i, int worker, void *arg) {
+    HenonJob *job = arg;
+    Attractor *at = job->at;
+    size_t size = (size_t) at->rows * at->cols;
+    uint64_t *dst = at->count + (size_t) i * at->cols;
+
+    for (int w = 0; w < parallel_threads(); w++) {
+        const uint32_t *src = job->hist + w * size + (size_t) i * at->cols;
+        for (int j = 0; j < at->cols; j++) {
+            dst[j] += src[j];
+        }
+    }
+}
+
+/**
+ * Add points iterations of the Henon map with parameters a and b (1.4 and 0.3
+ * give the classic attractor) to the counts. Orbits of ATTRACTOR_ORBIT points
+ * start from random points near the origin, chosen by seed, and are run in
+ * parallel with a histogram per thread. Returns 0, or -1 on failure.
+ */
+int attractor_henon(Attractor *at, double a, double b, long long points,
+                    unsigned int seed) {
+    HenonJob job;
+    int threads = parallel_threads();
+
+    if (!at) {
+        printf("attractor_henon(): passed NULL pointer.\n");
+        return -1;
+    }
+    if (points <= 0) {
+        return 0;
+    }
+
+    job.at = at;
+    job.a = a;
+    job.b = b;
+    job.points = points;
+    job.seed = seed;
+    job.hist = calloc((size_t) threads * at->rows * at->cols, sizeof(uint32_t));
+    if (!job.hist) {
+        printf("attractor_henon(): malloc() failed.\n");
+        return -1;
+    }
+
+    parallel_for((int) ((points + ATTRACTOR_ORBIT - 1) / ATTRACTOR_ORBIT),
+                 attractor_henonOrbit, &job);
+    parallel_for(at->rows, attractor_mergeRow, &job);
+    at->total += points;
+
+    free(job.hist);
+    return 0;
+}
+
+/**
+ * Tone map the counts into im, which must be the same size: each pixel gets
+ * color scaled by log(1 + hits) / log(1 + most hits), so detail in sparse
+ * regions stays visible next to the densest ones. A NULL color means white.
+ */
+void attractor_toImage(Attractor *at, Image *im, Color *color) {
+    Color white = {{1.0, 1.0, 1.0}};
+    uint64_t most = 0;
+    size_t size;
+    float lut[256];
+    float scale;
+
+    if (!at || !im) {
+        printf("attractor_toImage(): passed NULL pointer.\n");
+        return;
+    }
+    if (im->rows != at->rows || im->cols != at->cols) {
+        printf("attractor_toImage(): image and attractor sizes differ.\n");
+        return;
+    }
+    if (!color) {
+        color = &white;
+    }
+
+    size = (size_t) at->rows * at->cols;
+    for (size_t k = 0; k < size; k++) {
+        if (at->count[k] > most) {
+            most = at->count[k];
+        }
+    }
+    scale = most > 0 ? 1.0 / log1p((double) most) : 0.0;
+
+    // Most pixels hold small counts, so look those up
+    for (int n = 0; n < 256; n++) {
+        lut[n] = log1p((double) n) * scale;
+    }
+
+    for (size_t k = 0; k < size; k++) {
+        uint64_t n = at->count[k];
+        float v = n < 256 ? lut[n] : log1p((double) n) * scale;
+        for (int c = 0; c < 3; c++) {
+            im->data[k].rgb[c] = color->c[c] * v;
+        }
+    }
+}
@@ -5,6 +5,7 @@
  * drawing BezierCurves and Bezier Surfaces in an image using de Casteljau's
  * algorithm.
  */
+#include <string.h>
 #include "graphicslib.h"
 #include "bezier.h"
 
@@ -32,6 +33,7 @@ void bezierCurve_init(BezierCurve *b) {
 void bezierSurface_init(BezierSurface *b) {
     b->subdivisions = 0; // Zero unless set by bezierSurface_draw_with_subdivisions
     b->zBuffer = 1;
+    b->oneSided = 0;
     
     // X-axis points
     point_set3D(&(b->ctrls[0]), 0.0, 0.0, 0.0);
@@ -115,6 +117,7 @@ void bezierSurface_copy(BezierSurface *to, BezierSurface *from) {
     }
     to->subdivisions = from->subdivisions;
     to->zBuffer = from->zBuffer;
+    to->oneSided = from->oneSided;
 }
 
 /**
@@ -142,79 +145,253 @@ void bezierSurface_zBuffer(BezierCurve *b, int flag) {
     b->zBuffer = flag;
 }
 
+/**
+ * Mark the surface as one-sided when it is part of a closed surface and its
+ * (u, v) parameterization runs counter-clockwise seen from outside, so the
+ * normal du x dv points out. The triangles of a solid tessellation are then
+ * skipped when they face away from the viewer.
+ */
+void bezierSurface_oneSided(BezierSurface *b, int flag) {
+    if (!b) {
+        printf("bezierSurface_oneSided(): passed NULL pointer as argument.\n");
+        return;
+    }
+
+    b->oneSided = flag;
+}
+
+
+/* Curves are flattened with de Casteljau subdivision driven by an explicit
+stack rather than recursion, so drawing a curve does no heap allocation. Each
+split pops one span and pushes two, so the stack never holds more than one
+pending right half per level plus the span being split. */
+#define BEZIER_STACK_SIZE (BEZIER_MAX_DEPTH + 2)
+#define BEZIER_BATCH_SIZE 256 // Vertices buffered before each strip is drawn
+
+typedef struct {
+    Point ctrls[4];
+    int divisions; // Subdivisions remaining for this span
+} BezierSpan;
+
+/**
+ * Split the span s at t = 0.5 into its left and right halves. All four
+ * coordinates are interpolated so depth comes along for the z-buffer.
+ */
+static void bezierSpan_split(BezierSpan *s, BezierSpan *left,
+                             BezierSpan *right) {
+    double mid;
+
+    for (int k = 0; k < 4; k++) {
+        mid = (s->ctrls[1].val[k] + s->ctrls[2].val[k]) / 2;
+        left->ctrls[0].val[k] = s->ctrls[0].val[k];
+        left->ctrls[1].val[k] = (s->ctrls[0].val[k] + s->ctrls[1].val[k]) / 2;
+        left->ctrls[2].val[k] = (left->ctrls[1].val[k] + mid) / 2;
+        right->ctrls[3].val[k] = s->ctrls[3].val[k];
+        right->ctrls[2].val[k] = (s->ctrls[2].val[k] + s->ctrls[3].val[k]) / 2;
+        right->ctrls[1].val[k] = (mid + right->ctrls[2].val[k]) / 2;
+        left->ctrls[3].val[k] = (left->ctrls[2].val[k] +
+                                 right->ctrls[1].val[k]) / 2;
+        right->ctrls[0].val[k] = left->ctrls[3].val[k];
+    }
+    left->divisions = s->divisions - 1;
+    right->divisions = s->divisions - 1;
+}
+
+/**
+ * Returns the squared screen-space distance from (px, py) to the chord of the
+ * span, i.e. the segment from ctrls[0] to ctrls[3].
+ */
+static double bezierSpan_chordDist2(BezierSpan *s, double px, double py) {
+    double cx = s->ctrls[3].val[0] - s->ctrls[0].val[0];
+    double cy = s->ctrls[3].val[1] - s->ctrls[0].val[1];
+    double dx = px - s->ctrls[0].val[0];
+    double dy = py - s->ctrls[0].val[1];
+    double len2 = cx * cx + cy * cy;
+    double t = len2 > 0.0 ? (dx * cx + dy * cy) / len2 : 0.0;
+
+    // Clamp to the segment so control points overshooting an end still count
+    t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+    dx -= t * cx;
+    dy -= t * cy;
+    return dx * dx + dy * dy;
+}
+
+/**
+ * Returns 1 if the span is within tolerance pixels of its chord. The curve
+ * lies inside the convex hull of its control points, so bounding the distance
+ * of the two inner control points from the chord bounds the error of drawing
+ * the span as a single line.
+ */
+static int bezierSpan_flat(BezierSpan *s, double tolerance) {
+    double tol2 = tolerance * tolerance;
+
+    return bezierSpan_chordDist2(s, s->ctrls[1].val[0], s->ctrls[1].val[1])
+                <= tol2 &&
+           bezierSpan_chordDist2(s, s->ctrls[2].val[0], s->ctrls[2].val[1])
+                <= tol2;
+}
+
+/**
+ * Returns 1 if the span should be emitted rather than split further.
+ */
+static int bezierSpan_done(BezierSpan *s, int safetyFlag, double tolerance) {
+    double dx, dy;
+
+    if (s->divisions <= 0) {
+        return 1;
+    }
+    if (tolerance > 0.0) {
+        return bezierSpan_flat(s, tolerance);
+    }
+    if (!safetyFlag) {
+        return 0;
+    }
+
+    // Stop once the inner control points are within 10 pixels of each other
+    dx = s->ctrls[2].val[0] - s->ctrls[1].val[0];
+    dy = s->ctrls[2].val[1] - s->ctrls[1].val[1];
+    return dx * dx + dy * dy < 100.0;
+}
+
+/**
+ * Walk the subdivision of b, appending each finished span to vlist. If
+ * tolerance is positive, spans are split until they are within tolerance pixels
+ * of their chord and each one contributes just its end point; otherwise spans
+ * are split <divisions> times (see safetyFlag in
+ * bezierCurve_draw_with_subdivisions) and contribute their control polygon.
+ * If src is given, a full vlist is drawn as a line strip and restarted from its
+ * last vertex so the walk never runs out of room; otherwise the walk stops when
+ * vlist is full. Returns the number of vertices left in vlist.
+ */
+static int bezierCurve_walk(BezierCurve *b, int divisions, int safetyFlag,
+                            double tolerance, Point *vlist, int maxV,
+                            Image *src, Color c) {
+    BezierSpan stack[BEZIER_STACK_SIZE];
+    BezierSpan cur;
+    int top = 0;
+    int n = 0;
+
+    if (maxV < 4) {
+        return 0;
+    }
+    if (divisions > BEZIER_MAX_DEPTH) {
+        divisions = BEZIER_MAX_DEPTH;
+    }
+
+    for (int k = 0; k < 4; k++) {
+        point_copy(&stack[0].ctrls[k], &b->ctrls[k]);
+    }
+    stack[0].divisions = divisions;
+    top = 1;
+    point_copy(&vlist[n++], &b->ctrls[0]);
+
+    while (top > 0) {
+        cur = stack[--top];
+
+        if (!bezierSpan_done(&cur, safetyFlag, tolerance)) {
+            // Push the right half first so the left half is emitted first
+            bezierSpan_split(&cur, &stack[top + 1], &stack[top]);
+            top += 2;
+            continue;
+        }
+
+        if (n + 3 > maxV) {
+            if (!src) {
+                break;
+            }
+            line_drawStrip(vlist, n, b->zBuffer, src, c);
+            point_copy(&vlist[0], &vlist[n - 1]);
+            n = 1;
+        }
+
+        // A flat span is drawn as its chord, anything else as its polygon
+        if (tolerance <= 0.0 || !bezierSpan_flat(&cur, tolerance)) {
+            point_copy(&vlist[n++], &cur.ctrls[1]);
+            point_copy(&vlist[n++], &cur.ctrls[2]);
+        }
+        point_copy(&vlist[n++], &cur.ctrls[3]);
+    }
+
+    return n;
+}
+
+/**
+ * Flatten the Bezier curve into the caller-provided vertex list, which can hold
+ * up to maxV Points. The curve is subdivided <divisions> times (capped at
+ * BEZIER_MAX_DEPTH), or less if safetyFlag is set and the inner control points
+ * of a span are within 10 pixels of each other. A curve subdivided d times
+ * needs 3 * 2^d + 1 vertices; if vlist is too small the output is truncated.
+ * Returns the number of vertices written.
+ */
+int bezierCurve_flatten(BezierCurve *b, int divisions, int safetyFlag,
+                        Point *vlist, int maxV) {
+    Color unused = {{0.0, 0.0, 0.0}};
+
+    if (!b || !vlist) {
+        printf("bezierCurve_flatten(): passed NULL pointer as argument.\n");
+        return 0;
+    }
+
+    return bezierCurve_walk(b, divisions, safetyFlag, 0.0, vlist, maxV, NULL,
+                            unused);
+}
+
+/**
+ * Flatten the Bezier curve, given in screen coordinates, into the caller-
+ * provided vertex list so that no point of the curve is more than tolerance
+ * pixels from the resulting polyline. Straight stretches collapse to a single
+ * segment while tight bends get as many as they need. If vlist is too small
+ * the output is truncated. Returns the number of vertices written.
+ */
+int bezierCurve_flattenAdaptive(BezierCurve *b, double tolerance,
+                                Point *vlist, int maxV) {
+    Color unused = {{0.0, 0.0, 0.0}};
+
+    if (!b || !vlist) {
+        printf("bezierCurve_flattenAdaptive(): passed NULL pointer as "\
+        "argument.\n");
+        return 0;
+    }
+    if (tolerance <= 0.0) {
+        printf("bezierCurve_flattenAdaptive(): tolerance must be positive.\n");
+        return 0;
+    }
+
+    return bezierCurve_walk(b, BEZIER_MAX_DEPTH, 0, tolerance, vlist, maxV,
+                            NULL, unused);
+}
+
 /**
  * Draws the Bezier curve, given in screen coordinates, into the image using the
  * given color. The function is adaptive so that it uses an appropriate 
- * number of line segments to draw the curve. Specifically, if the diagonal of
- * the bounding box defined by the first and last line on the curve is shorter
- * than 10 pixels, the function ceases to subdivide.
+ * number of line segments to draw the curve - spans are subdivided until they
+ * are within BEZIER_TOLERANCE pixels of a straight line.
  */
 void bezierCurve_draw(BezierCurve *b, Image *src, Color c) {
-    Line *l = malloc(sizeof(Line));
-
-    // Calculate diagonal of bounding box:
-    float distance = sqrt(
-        (b->ctrls[2].val[0] - b->ctrls[1].val[0]) * (b->ctrls[2].val[0] - b->ctrls[1].val[0]) +
-        (b->ctrls[2].val[1] - b->ctrls[1].val[1]) * (b->ctrls[2].val[1] - b->ctrls[1].val[1])
-    );
-
-    if (distance < 10.0) {
-        line_set(l, b->ctrls[0], b->ctrls[1]);
-        line_draw(l, src, c);
-        line_set(l, b->ctrls[1], b->ctrls[2]);
-        line_draw(l, src, c);
-        line_set(l, b->ctrls[2], b->ctrls[3]);
-        line_draw(l, src, c);
-        free(l);
-        return;
-    }
+    bezierCurve_drawAdaptive(b, BEZIER_TOLERANCE, src, c);
+}
 
-    // Split the curve into two bezier curves and draw those recursively:
-    BezierCurve *left = malloc(sizeof(BezierCurve));
-    BezierCurve *right = malloc(sizeof(BezierCurve));
+/**
+ * Draws the Bezier curve, given in screen coordinates, as a polyline that is
+ * never more than tolerance pixels away from the true curve.
+ */
+void bezierCurve_drawAdaptive(BezierCurve *b, double tolerance, Image *src,
+                              Color c) {
+    Point vlist[BEZIER_BATCH_SIZE];
+    int n;
 
-    bezierCurve_init(left);
-    bezierCurve_init(right);
+    if (!b || !src) {
+        printf("bezierCurve_drawAdaptive(): passed NULL pointer.\n");
+        return;
+    }
+    if (tolerance <= 0.0) {
+        printf("bezierCurve_drawAdaptive(): tolerance must be positive.\n");
+        return;
+    }
 
-    // Define left curve ctl points:
-    point_copy(&(left->ctrls[0]), &(b->ctrls[0])); // q0
-    left->ctrls[1].val[0] = (b->ctrls[0].val[0] + b->ctrls[1].val[0]) / 2;// q1x
-    left->ctrls[1].val[1] = (b->ctrls[0].val[1] + b->ctrls[1].val[1]) / 2;// q1y
-    left->ctrls[1].val[2] = (b->ctrls[0].val[2] + b->ctrls[1].val[2]) / 2;// q1z
-    
-    left->ctrls[2].val[0] = ((left->ctrls[1].val[0]) / 2) +
-                            ((b->ctrls[1].val[0] + b->ctrls[2].val[0]) / 4);
-    left->ctrls[2].val[1] = ((left->ctrls[1].val[1]) / 2) +
-                            ((b->ctrls[1].val[1] + b->ctrls[2].val[1]) / 4);
-    left->ctrls[2].val[2] = ((left->ctrls[1].val[2]) / 2) +
-                            ((b->ctrls[1].val[2] + b->ctrls[2].val[2]) / 4);
-
-    // Define right curve ctl points:
-    point_copy(&(right->ctrls[3]), &(b->ctrls[3])); // r3
-    right->ctrls[2].val[0] = (b->ctrls[2].val[0] + b->ctrls[3].val[0]) / 2;// r1x
-    right->ctrls[2].val[1] = (b->ctrls[2].val[1] + b->ctrls[3].val[1]) / 2;// r1y
-    right->ctrls[2].val[2] = (b->ctrls[2].val[2] + b->ctrls[3].val[2]) / 2;// r1y
-
-    right->ctrls[1].val[0] = ((right->ctrls[2].val[0]) / 2) +
-                            ((b->ctrls[1].val[0] + b->ctrls[2].val[0]) / 4);
-    right->ctrls[1].val[1] = ((right->ctrls[2].val[1]) / 2) +
-                            ((b->ctrls[1].val[1] + b->ctrls[2].val[1]) / 4);
-    right->ctrls[1].val[2] = ((right->ctrls[2].val[2]) / 2) +
-                            ((b->ctrls[1].val[2] + b->ctrls[2].val[2]) / 4);
-
-    // Define point where two curves meet:
-    left->ctrls[3].val[0] = (left->ctrls[2].val[0] + right->ctrls[1].val[0]) / 2;
-    left->ctrls[3].val[1] = (left->ctrls[2].val[1] + right->ctrls[1].val[1]) / 2;
-    left->ctrls[3].val[2] = (left->ctrls[2].val[2] + right->ctrls[1].val[2]) / 2;
-    point_copy(&(right->ctrls[0]), &(left->ctrls[3]));
-
-    // Recursively draw each side:
-    bezierCurve_draw(left, src, c);
-    bezierCurve_draw(right, src, c);
-
-    free(l);
-    free(left);
-    free(right);
+    n = bezierCurve_walk(b, BEZIER_MAX_DEPTH, 0, tolerance, vlist,
+                         BEZIER_BATCH_SIZE, src, c);
+    line_drawStrip(vlist, n, b->zBuffer, src, c);
 }
 
 /**
@@ -227,74 +404,399 @@ void bezierCurve_draw(BezierCurve *b, Image *src, Color c) {
  */
 void bezierCurve_draw_with_subdivisions(BezierCurve *b, int divisions,
                                         int safetyFlag, Image *src, Color c) {
-    Line *l = malloc(sizeof(Line));
-    float distance = sqrt(
-        (b->ctrls[2].val[0] - b->ctrls[1].val[0]) * (b->ctrls[2].val[0] - b->ctrls[1].val[0]) +
-        (b->ctrls[2].val[1] - b->ctrls[1].val[1]) * (b->ctrls[2].val[1] - b->ctrls[1].val[1])
-    );
-
-    // If using in safe mode, draw when points are less than 10.0 units from
-    // each other to prevent tearing:
-    if (safetyFlag && distance < 10.0) {
-        line_set(l, b->ctrls[0], b->ctrls[1]);
-        line_draw(l, src, c);
-        line_set(l, b->ctrls[1], b->ctrls[2]);
-        line_draw(l, src, c);
-        line_set(l, b->ctrls[2], b->ctrls[3]);
-        line_draw(l, src, c);
-        free(l);
+    Point vlist[BEZIER_BATCH_SIZE];
+    int n;
+
+    if (!b || !src) {
+        printf("bezierCurve_draw_with_subdivisions(): passed NULL pointer.\n");
         return;
     }
 
-    // Otherwise, subdivide all the way down to zero:
-    if (divisions == 0) {
-        line_set(l, b->ctrls[0], b->ctrls[1]);
-        line_draw(l, src, c);
-        line_set(l, b->ctrls[1], b->ctrls[2]);
-        line_draw(l, src, c);
-        line_set(l, b->ctrls[2], b->ctrls[3]);
-        line_draw(l, src, c);
-        free(l);
-        return;
+    n = bezierCurve_walk(b, divisions, safetyFlag, 0.0, vlist,
+                         BEZIER_BATCH_SIZE, src, c);
+    line_drawStrip(vlist, n, b->zBuffer, src, c);
+}
+
+
+/* Surfaces are tessellated by evaluating the patch directly on a regular (u,v)
+grid. The cubic Bernstein weights and their derivatives only depend on the grid
+resolution, so they are computed once per patch and shared by both parameter
+directions. */
+
+/**
+ * Fill w and dw with the four cubic Bernstein weights at t and their
+ * derivatives with respect to t.
+ */
+static void bezier_bernstein(double t, double *w, double *dw) {
+    double s = 1.0 - t;
+
+    w[0] = s * s * s;
+    w[1] = 3.0 * t * s * s;
+    w[2] = 3.0 * t * t * s;
+    w[3] = t * t * t;
+
+    dw[0] = -3.0 * s * s;
+    dw[1] = 3.0 * s * s - 6.0 * t * s;
+    dw[2] = 6.0 * t * s - 3.0 * t * t;
+    dw[3] = 3.0 * t * t;
+}
+
+/**
+ * Evaluate the surface normal of the patch at (u, v) as the cross product of
+ * the partial derivatives. The result is not normalized.
+ */
+static void bezierSurface_normalAt(BezierSurface *b, double u, double v,
+                                     Vector *n) {
+    double wu[4], dwu[4], wv[4], dwv[4];
+    Vector du, dv;
+
+    bezier_bernstein(u, wu, dwu);
+    bezier_bernstein(v, wv, dwv);
+    vector_set(&du, 0.0, 0.0, 0.0);
+    vector_set(&dv, 0.0, 0.0, 0.0);
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            for (int k = 0; k < 3; k++) {
+                du.val[k] += wv[i] * dwu[j] * b->ctrls[i*4 + j].val[k];
+                dv.val[k] += dwv[i] * wu[j] * b->ctrls[i*4 + j].val[k];
+            }
+        }
     }
+    vector_cross(&du, &dv, n);
+}
 
-    // Split the curve into two bezier curves and draw those recursively:
-    BezierCurve *left = malloc(sizeof(BezierCurve));
-    BezierCurve *right = malloc(sizeof(BezierCurve));
+/**
+ * Clamp a surface subdivision level to the supported range.
+ */
+static int bezier_clampDivisions(int divisions) {
+    if (divisions < 0) {
+        return 0;
+    }
+    if (divisions > BEZIER_SURFACE_MAX_DEPTH) {
+        return BEZIER_SURFACE_MAX_DEPTH;
+    }
+    return divisions;
+}
 
-    bezierCurve_init(left);
-    bezierCurve_init(right);
+/**
+ * Returns 1 if the triangle (a, b, c) has no area.
+ */
+static int bezier_degenerate(Point *a, Point *b, Point *c) {
+    Vector ab, ac, n;
 
-    // Define left curve ctl points:
-    point_copy(&(left->ctrls[0]), &(b->ctrls[0])); // q0
-    left->ctrls[1].val[0] = (b->ctrls[0].val[0] + b->ctrls[1].val[0]) / 2;// q1x
-    left->ctrls[1].val[1] = (b->ctrls[0].val[1] + b->ctrls[1].val[1]) / 2;// q1y
+    vector_set(&ab, b->val[0] - a->val[0], b->val[1] - a->val[1],
+               b->val[2] - a->val[2]);
+    vector_set(&ac, c->val[0] - a->val[0], c->val[1] - a->val[1],
+               c->val[2] - a->val[2]);
+    vector_cross(&ab, &ac, &n);
 
-    left->ctrls[2].val[0] = ((left->ctrls[1].val[0]) / 2) +
-                            ((b->ctrls[1].val[0] + b->ctrls[2].val[0]) / 4);
-    left->ctrls[2].val[1] = ((left->ctrls[1].val[1]) / 2) +
-                            ((b->ctrls[1].val[1] + b->ctrls[2].val[1]) / 4);
-    
-    // Define right curve ctl points:
-    point_copy(&(right->ctrls[3]), &(b->ctrls[3])); // r3
-    right->ctrls[2].val[0] = (b->ctrls[2].val[0] + b->ctrls[3].val[0]) / 2;// r1x
-    right->ctrls[2].val[1] = (b->ctrls[2].val[1] + b->ctrls[3].val[1]) / 2;// r1y
-
-    right->ctrls[1].val[0] = ((right->ctrls[2].val[0]) / 2) +
-                            ((b->ctrls[1].val[0] + b->ctrls[2].val[0]) / 4);
-    right->ctrls[1].val[1] = ((right->ctrls[2].val[1]) / 2) +
-                            ((b->ctrls[1].val[1] + b->ctrls[2].val[1]) / 4);
-
-    // Define point where two curves meet:
-    left->ctrls[3].val[0] = (left->ctrls[2].val[0] + right->ctrls[1].val[0]) / 2;
-    left->ctrls[3].val[1] = (left->ctrls[2].val[1] + right->ctrls[1].val[1]) / 2;
-    point_copy(&(right->ctrls[0]), &(left->ctrls[3]));
-
-    // Recursively draw each side:
-    bezierCurve_draw_with_subdivisions(left, divisions - 1, safetyFlag, src, c);
-    bezierCurve_draw_with_subdivisions(right, divisions - 1, safetyFlag, src, c);
-
-    free(l);
-    free(left);
-    free(right);
-}
\ No newline at end of file
+    return vector_length(&n) < 1e-12;
+}
+
+/**
+ * Tessellate the surface into an indexed Mesh sampled on a grid of
+ * (3 << divisions) segments in each direction, which matches the density of
+ * the control nets produced by the same number of de Casteljau subdivisions.
+ * Every grid vertex is stored once with its own normal. Solid meshes hold two
+ * triangles per grid cell, with triangles that collapse at degenerate patch
+ * edges left out; wireframe meshes hold each grid line segment exactly once.
+ * Returns NULL on failure.
+ */
+Mesh *bezierSurface_tessellate(BezierSurface *b, int divisions, int solid) {
+    double w[BEZIER_SURFACE_MAX_SEGMENTS + 1][4];
+    double dw[BEZIER_SURFACE_MAX_SEGMENTS + 1][4];
+    Point q[4];
+    Vector dq[4], du, dv, n;
+    Mesh *mesh;
+    int segs, side, idx, row, col;
+
+    if (!b) {
+        printf("bezierSurface_tessellate(): passed NULL pointer.\n");
+        return NULL;
+    }
+
+    divisions = bezier_clampDivisions(divisions);
+    segs = 3 << divisions;
+    side = segs + 1;
+
+    mesh = mesh_create(side * side, solid ? 2 * segs * segs : 0,
+                       solid ? 0 : 2 * segs * side);
+    if (!mesh) {
+        return NULL;
+    }
+    mesh->solid = solid ? 1 : 0;
+    mesh->oneSided = solid && b->oneSided;
+    mesh->zBuffer = b->zBuffer;
+
+    for (int s = 0; s <= segs; s++) {
+        bezier_bernstein((double) s / segs, w[s], dw[s]);
+    }
+
+    for (row = 0; row <= segs; row++) {
+        // Collapse the rows of control points into a curve at this v
+        for (int j = 0; j < 4; j++) {
+            point_set(&q[j], 0.0, 0.0, 0.0, 1.0);
+            vector_set(&dq[j], 0.0, 0.0, 0.0);
+            for (int i = 0; i < 4; i++) {
+                for (int k = 0; k < 3; k++) {
+                    q[j].val[k] += w[row][i] * b->ctrls[i*4 + j].val[k];
+                    dq[j].val[k] += dw[row][i] * b->ctrls[i*4 + j].val[k];
+                }
+            }
+        }
+
+        for (col = 0; col <= segs; col++) {
+            idx = row * side + col;
+            Point *p = &(mesh->vertex[idx]);
+            point_set(p, 0.0, 0.0, 0.0, 1.0);
+            vector_set(&du, 0.0, 0.0, 0.0);
+            vector_set(&dv, 0.0, 0.0, 0.0);
+            for (int j = 0; j < 4; j++) {
+                for (int k = 0; k < 3; k++) {
+                    p->val[k] += w[col][j] * q[j].val[k];
+                    du.val[k] += dw[col][j] * q[j].val[k];
+                    dv.val[k] += w[col][j] * dq[j].val[k];
+                }
+            }
+            vector_cross(&du, &dv, &n);
+
+            /* Where a patch edge collapses to a point the derivatives vanish,
+            so take the normal from just inside the patch instead. */
+            if (vector_length(&n) < 1e-12) {
+                double u = (double) col / segs, v = (double) row / segs;
+                double eps = 1e-3;
+                bezierSurface_normalAt(b, u + (u < 0.5 ? eps : -eps),
+                                       v + (v < 0.5 ? eps : -eps), &n);
+            }
+            if (vector_length(&n) > 0.0) {
+                vector_normalize(&n);
+            }
+            vector_copy(&(mesh->normal[idx]), &n);
+        }
+    }
+
+    if (solid) {
+        int *t = mesh->triangle;
+        Point *v = mesh->vertex;
+        mesh->nTriangle = 0;
+        for (row = 0; row < segs; row++) {
+            for (col = 0; col < segs; col++) {
+                int a = row * side + col;
+                int c[4] = {a, a + 1, a + side + 1, a + side};
+
+                if (!bezier_degenerate(&v[c[0]], &v[c[1]], &v[c[2]])) {
+                    t[0] = c[0];
+                    t[1] = c[1];
+                    t[2] = c[2];
+                    t += 3;
+                    mesh->nTriangle++;
+                }
+                if (!bezier_degenerate(&v[c[0]], &v[c[2]], &v[c[3]])) {
+                    t[0] = c[0];
+                    t[1] = c[2];
+                    t[2] = c[3];
+                    t += 3;
+                    mesh->nTriangle++;
+                }
+            }
+        }
+    } else {
+        int *e = mesh->edge;
+        for (row = 0; row <= segs; row++) {
+            for (col = 0; col < segs; col++) {
+                // Segment along u, then the matching segment along v
+                e[0] = row * side + col;
+                e[1] = row * side + col + 1;
+                e[2] = col * side + row;
+                e[3] = (col + 1) * side + row;
+                e += 4;
+            }
+        }
+    }
+
+    return mesh;
+}
+
+
+/* Tessellation cache. Meshes are keyed on the exact bits of the 16 control
+points plus the tessellation parameters, found through a chained hash table and
+kept in least-recently-used order. The cache owns one reference to each Mesh it
+holds, so evicting an entry never invalidates a Mesh still used by a module.
+The cache is not thread safe. */
+#define BEZIER_CACHE_BUCKETS 1024
+
+typedef struct BezierCacheEntry {
+    Point ctrls[16];
+    int divisions;
+    int solid;
+    int zBuffer;
+    int oneSided;
+    unsigned long hash;
+    size_t bytes; // memory charged to the cache for this entry
+    Mesh *mesh;
+    struct BezierCacheEntry *chain; // next entry in the same bucket
+    struct BezierCacheEntry *newer; // LRU neighbours
+    struct BezierCacheEntry *older;
+} BezierCacheEntry;
+
+static BezierCacheEntry *bezierCache_buckets[BEZIER_CACHE_BUCKETS];
+static BezierCacheEntry *bezierCache_newest = NULL;
+static BezierCacheEntry *bezierCache_oldest = NULL;
+static size_t bezierCache_bytes = 0;
+static size_t bezierCache_limit = BEZIER_CACHE_LIMIT;
+
+/**
+ * FNV-1a hash of the control points and tessellation parameters.
+ */
+static unsigned long bezierCache_hash(Point *ctrls, int divisions, int solid,
+                                      int zBuffer, int oneSided) {
+    unsigned long h = 2166136261UL;
+    const unsigned char *bytes = (const unsigned char *) ctrls;
+    int params[4] = {divisions, solid, zBuffer, oneSided};
+
+    for (size_t i = 0; i < sizeof(Point) * 16; i++) {
+        h = (h ^ bytes[i]) * 16777619UL;
+    }
+    bytes = (const unsigned char *) params;
+    for (size_t i = 0; i < sizeof(params); i++) {
+        h = (h ^ bytes[i]) * 16777619UL;
+    }
+
+    return h;
+}
+
+/**
+ * Unlink the entry from the LRU list.
+ */
+static void bezierCache_unlink(BezierCacheEntry *e) {
+    if (e->newer) {
+        e->newer->older = e->older;
+    } else {
+        bezierCache_newest = e->older;
+    }
+    if (e->older) {
+        e->older->newer = e->newer;
+    } else {
+        bezierCache_oldest = e->newer;
+    }
+    e->newer = NULL;
+    e->older = NULL;
+}
+
+/**
+ * Put the entry at the most recently used end of the LRU list.
+ */
+static void bezierCache_pushNewest(BezierCacheEntry *e) {
+    e->newer = NULL;
+    e->older = bezierCache_newest;
+    if (bezierCache_newest) {
+        bezierCache_newest->newer = e;
+    } else {
+        bezierCache_oldest = e;
+    }
+    bezierCache_newest = e;
+}
+
+/**
+ * Remove the entry from the cache and drop the cache's reference to its Mesh.
+ */
+static void bezierCache_remove(BezierCacheEntry *e) {
+    BezierCacheEntry **link = &bezierCache_buckets[e->hash % BEZIER_CACHE_BUCKETS];
+
+    while (*link != e) {
+        link = &((*link)->chain);
+    }
+    *link = e->chain;
+    bezierCache_unlink(e);
+    bezierCache_bytes -= e->bytes;
+    mesh_free(e->mesh);
+    free(e);
+}
+
+/**
+ * Evict least recently used entries until the cache fits within its limit.
+ */
+static void bezierCache_trim(void) {
+    while (bezierCache_oldest && bezierCache_bytes > bezierCache_limit) {
+        bezierCache_remove(bezierCache_oldest);
+    }
+}
+
+/**
+ * Return a Mesh for the surface exactly as bezierSurface_tessellate() would,
+ * reusing a previously built Mesh when the same control points have already
+ * been tessellated with the same parameters. The caller receives its own
+ * reference and must release it with mesh_free(). Meshes returned by this
+ * function are shared and must not be modified. Returns NULL on failure.
+ */
+Mesh *bezierSurface_tessellateCached(BezierSurface *b, int divisions,
+                                     int solid) {
+    BezierCacheEntry *e;
+    unsigned long hash;
+
+    if (!b) {
+        printf("bezierSurface_tessellateCached(): passed NULL pointer.\n");
+        return NULL;
+    }
+
+    divisions = bezier_clampDivisions(divisions);
+    solid = solid ? 1 : 0;
+    hash = bezierCache_hash(b->ctrls, divisions, solid, b->zBuffer,
+                            b->oneSided);
+
+    for (e = bezierCache_buckets[hash % BEZIER_CACHE_BUCKETS]; e; e = e->chain) {
+        if (e->hash == hash && e->divisions == divisions &&
+            e->solid == solid && e->zBuffer == b->zBuffer &&
+            e->oneSided == b->oneSided &&
+            !memcmp(e->ctrls, b->ctrls, sizeof(e->ctrls))) {
+            bezierCache_unlink(e);
+            bezierCache_pushNewest(e);
+            return mesh_retain(e->mesh);
+        }
+    }
+
+    Mesh *mesh = bezierSurface_tessellate(b, divisions, solid);
+    if (!mesh) {
+        return NULL;
+    }
+
+    e = malloc(sizeof(BezierCacheEntry));
+    if (!e) { // Still usable, just not cached
+        return mesh;
+    }
+    memcpy(e->ctrls, b->ctrls, sizeof(e->ctrls));
+    e->divisions = divisions;
+    e->solid = solid;
+    e->zBuffer = b->zBuffer;
+    e->oneSided = b->oneSided;
+    e->hash = hash;
+    e->bytes = mesh_size(mesh) + sizeof(BezierCacheEntry);
+    e->mesh = mesh_retain(mesh);
+    e->chain = bezierCache_buckets[hash % BEZIER_CACHE_BUCKETS];
+    bezierCache_buckets[hash % BEZIER_CACHE_BUCKETS] = e;
+    bezierCache_pushNewest(e);
+    bezierCache_bytes += e->bytes;
+    bezierCache_trim();
+
+    return mesh;
+}
+
+/**
+ * Set the most memory, in bytes, the tessellation cache may hold, evicting
+ * the least recently used meshes if it is already over the new limit. A limit
+ * of 0 disables caching.
+ */
+void bezierSurface_setCacheLimit(size_t bytes) {
+    bezierCache_limit = bytes;
+    bezierCache_trim();
+}
+
+/**
+ * Empty the tessellation cache. Meshes still referenced by modules are kept
+ * alive until those modules release them.
+ */
+void bezierSurface_clearCache(void) {
+    while (bezierCache_oldest) {
+        bezierCache_remove(bezierCache_oldest);
+    }
+}
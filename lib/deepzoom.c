@@ -0,0 +1,246 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Implements deepzoom.h.
+ *
+ * With the reference point C and its orbit Z_n (Z_0 = 0, Z_{n+1} = Z_n^2 - C),
+ * a pixel c = C + dc has the orbit z_n = Z_n + d_n where
+ *
+ *     d_{n+1} = 2 Z_n d_n + d_n^2 - dc,
+ *
+ * which only involves small numbers and so can be iterated in doubles. When
+ * |z_n| falls below |d_n| (the reference is no longer a good approximation, the
+ * source of perturbation "glitches") or the reference orbit runs out, the pixel
+ * is rebased: d becomes the full value z and iteration continues from Z_0.
+ *
+ * Early iterations are skipped for every pixel at once with a series
+ * approximation d_n = A_n dc + B_n dc^2 + C_n dc^3, whose coefficients follow
+ *
+ *     A_{n+1} = 2 Z_n A_n - 1,  B_{n+1} = 2 Z_n B_n + A_n^2,
+ *     C_{n+1} = 2 Z_n C_n + 2 A_n B_n.
+ *
+ * It is evaluated at u = dc / r, r being the largest |dc| in the image, as
+ * d_n = r (a u + b u^2 + c u^3) with a = A_n, b = r B_n and c = r^2 C_n, which
+ * keeps the coefficients in double range at any zoom. The series is used
+ * until the cubic term stops being negligible next to the linear one, or
+ * until some pixel of the image could have escaped.
+ */
+#include "graphicslib.h"
+#include "deepzoom.h"
+
+typedef struct {
+    Image *im;
+    int maxIter;
+    double pw; // pixel width
+    double radius; // largest |dc| in the image
+    double *zx, *zy; // reference orbit, refLen entries
+    int refLen;
+    int skip; // iterations covered by the series approximation
+    double ax, ay, bx, by, cx3, cy3; // series coefficients at skip, rescaled by r
+} DeepJob;
+
+/**
+ * Return the escape iteration of the pixel at offset (dcx, dcy) from the
+ * reference, counted the same way as mandelbrot_escape().
+ */
+static int deep_escape(DeepJob *job, double dcx, double dcy) {
+    double dx = 0.0, dy = 0.0, t;
+    int m = 0, n = 0;
+
+    // Start from the series approximation, evaluated at u = dc / radius
+    if (job->skip > 0) {
+        double ux = dcx / job->radius, uy = dcy / job->radius;
+        double u2x = ux * ux - uy * uy, u2y = 2 * ux * uy;
+        double u3x = u2x * ux - u2y * uy, u3y = u2x * uy + u2y * ux;
+
+        dx = job->radius * (job->ax * ux - job->ay * uy + job->bx * u2x -
+                            job->by * u2y + job->cx3 * u3x - job->cy3 * u3y);
+        dy = job->radius * (job->ax * uy + job->ay * ux + job->bx * u2y +
+                            job->by * u2x + job->cx3 * u3y + job->cy3 * u3x);
+        m = n = job->skip;
+    }
+
+    while (n < job->maxIter) {
+        double Zx = job->zx[m], Zy = job->zy[m];
+
+        // d = 2 Z d + d^2 - dc
+        t = 2 * (Zx * dx - Zy * dy) + dx * dx - dy * dy - dcx;
+        dy = 2 * (Zx * dy + Zy * dx) + 2 * dx * dy - dcy;
+        dx = t;
+        m++;
+        n++;
+
+        double zx = job->zx[m] + dx, zy = job->zy[m] + dy;
+        double mag = zx * zx + zy * zy;
+        if (mag > 4.0) {
+            return n - 1;
+        }
+
+        // Rebase onto the start of the reference orbit
+        if (mag < dx * dx + dy * dy || m == job->refLen - 1) {
+            dx = zx;
+            dy = zy;
+            m = 0;
+        }
+    }
+
+    return job->maxIter > 0 ? job->maxIter - 1 : 0;
+}
+
+static void deep_renderRow(int i, int worker, void *arg) {
+    DeepJob *job = arg;
+    Image *im = job->im;
+    double dcy = (im->rows / 2 - i) * job->pw;
+
+    for (int j = 0; j < im->cols; j++) {
+        double dcx = (j - im->cols / 2) * job->pw;
+        int numIters = deep_escape(job, dcx, dcy);
+
+        // color pixel (i, j) the same way as mandelbrot()
+        image_setc(im, i, j, 0, log((double) numIters));
+        image_setc(im, i, j, 2, 1.0 / log(((double) numIters)));
+    }
+}
+
+/**
+ * Compute the reference orbit of (cx, cy) in multi-precision, stored as
+ * doubles, stopping after it escapes. Returns its length.
+ */
+static int deep_referenceOrbit(DeepJob *job, MPFixed *cx, MPFixed *cy) {
+    MPFixed zx, zy, xx, yy, xy;
+    int limbs = cx->limbs < cy->limbs ? cx->limbs : cy->limbs;
+    int n;
+
+    mp_set(&zx, 0.0, limbs);
+    mp_set(&zy, 0.0, limbs);
+    for (n = 0; n <= job->maxIter; n++) {
+        job->zx[n] = mp_toDouble(&zx);
+        job->zy[n] = mp_toDouble(&zy);
+        if (job->zx[n] * job->zx[n] + job->zy[n] * job->zy[n] > 4.0) {
+            return n + 1;
+        }
+
+        // Z = Z^2 - C
+        mp_mul(&zx, &zx, &xx);
+        mp_mul(&zy, &zy, &yy);
+        mp_mul(&zx, &zy, &xy);
+        mp_sub(&xx, &yy, &zx);
+        mp_sub(&zx, cx, &zx);
+        mp_add(&xy, &xy, &zy);
+        mp_sub(&zy, cy, &zy);
+    }
+
+    return job->maxIter + 1;
+}
+
+/**
+ * Advance the scaled series coefficients along the reference orbit for as
+ * long as the cubic term stays below DEEPZOOM_SA_TOLERANCE of the linear term,
+ * leaving the result and the number of iterations skipped in job.
+ */
+static void deep_series(DeepJob *job) {
+    double ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+    double r = job->radius;
+    int n;
+
+    for (n = 0; n < job->refLen - 2 && n < job->maxIter - 1; n++) {
+        double Zx = job->zx[n], Zy = job->zy[n];
+        double nax, nay, nbx, nby, ncx, ncy;
+
+        // a = 2 Z a - 1, b = 2 Z b + r a^2, c = 2 Z c + 2 r a b
+        nax = 2 * (Zx * ax - Zy * ay) - 1.0;
+        nay = 2 * (Zx * ay + Zy * ax);
+        nbx = 2 * (Zx * bx - Zy * by) + r * (ax * ax - ay * ay);
+        nby = 2 * (Zx * by + Zy * bx) + r * 2 * ax * ay;
+        ncx = 2 * (Zx * cx - Zy * cy) + r * 2 * (ax * bx - ay * by);
+        ncy = 2 * (Zx * cy + Zy * cx) + r * 2 * (ax * by + ay * bx);
+
+        if (!(hypot(ncx, ncy) <= DEEPZOOM_SA_TOLERANCE * hypot(nax, nay))) {
+            break;
+        }
+
+        // Escapes are not checked while skipping, so stop before any pixel
+        // could leave the radius-2 disk (|u| <= 1 bounds every term)
+        if (hypot(job->zx[n + 1], job->zy[n + 1]) + r * (hypot(nax, nay) +
+            hypot(nbx, nby) + hypot(ncx, ncy)) >= 2.0) {
+            break;
+        }
+
+        ax = nax; ay = nay;
+        bx = nbx; by = nby;
+        cx = ncx; cy = ncy;
+    }
+
+    job->skip = n;
+    job->ax = ax; job->ay = ay;
+    job->bx = bx; job->by = by;
+    job->cx3 = cx; job->cy3 = cy;
+}
+
+/**
+ * Render the Mandelbrot set into im around the centre (cx, cy), with the
+ * image dx wide in the complex plane, iterating at most maxIter times. The
+ * centre should carry at least mp_limbsFor(dx / im->cols) limbs. Rows are
+ * computed in parallel. Returns the number of iterations skipped by the
+ * series approximation, or -1 on failure.
+ */
+int mandelbrot_deep(Image *im, MPFixed *cx, MPFixed *cy, double dx, int maxIter) {
+    DeepJob job;
+
+    if (!im || !cx || !cy) {
+        printf("mandelbrot_deep(): passed NULL pointer.\n");
+        return -1;
+    }
+    if (maxIter <= 0 || im->cols <= 0 || dx <= 0.0) {
+        printf("mandelbrot_deep(): invalid view.\n");
+        return -1;
+    }
+
+    image_reset(im);
+    job.im = im;
+    job.maxIter = maxIter;
+    job.pw = dx / im->cols;
+    job.radius = job.pw * hypot(im->cols / 2 + 1, im->rows / 2 + 1);
+    job.zx = malloc(sizeof(double) * (maxIter + 1));
+    job.zy = malloc(sizeof(double) * (maxIter + 1));
+    if (!job.zx || !job.zy) {
+        printf("mandelbrot_deep(): malloc() failed.\n");
+        free(job.zx);
+        free(job.zy);
+        return -1;
+    }
+
+    job.refLen = deep_referenceOrbit(&job, cx, cy);
+    deep_series(&job);
+    parallel_for(im->rows, deep_renderRow, &job);
+
+    free(job.zx);
+    free(job.zy);
+
+    return job.skip;
+}
+
+/**
+ * Easy to use version of mandelbrot_deep(). The centre is given as decimal
+ * strings so it can carry as many digits as the zoom needs, e.g.
+ * image_mandelbrotDeep("0.743643887037158704752191506114774",
+ * "-0.131825904205311970493132056385139", 1e-30, 360, 640, 20000).
+ * Returns NULL if either coordinate cannot be parsed.
+ */
+Image *image_mandelbrotDeep(const char *cx, const char *cy, double dx, int rows,
+                            int cols, int maxIter) {
+    MPFixed x, y;
+    Image *im;
+    int limbs = mp_limbsFor(dx / (cols > 0 ? cols : 1));
+
+    if (mp_setString(&x, cx, limbs) || mp_setString(&y, cy, limbs)) {
+        printf("image_mandelbrotDeep(): could not parse the centre.\n");
+        return NULL;
+    }
+
+    im = image_create(rows, cols);
+    if (im) {
+        mandelbrot_deep(im, &x, &y, dx, maxIter);
+    }
+    return im;
+}
@@ -27,6 +27,10 @@ DrawState *drawstate_create(void) {
     point_set3D(&(toReturn->viewer), 1.0, 1.0, 1.0); // default VRP = (1,1,1)
     toReturn->surfaceCoeff = 0.5;
     toReturn->zBufferFlag = 1;
+    /* Without a view only geometry behind the center of projection is
+    clipped; view3D_setClip() tightens this to the front/back planes */
+    toReturn->clipNear = 1e-6;
+    toReturn->clipFar = HUGE_VAL;
     return toReturn;
 }
 
@@ -74,6 +78,20 @@ void drawstate_setSurfaceCoeff(DrawState *s, float f) {
     s->surfaceCoeff = f;
 }
 
+/**
+ * Set the range of homogeneous coordinates that module_draw() keeps when
+ * clipping polygons. For a perspective VTM the homogeneous coordinate is the
+ * distance from the center of projection divided by d.
+ */
+void drawstate_setClip(DrawState *s, double clipNear, double clipFar) {
+    if (!s) {
+        printf("drawstate_setClip(): passed NULL pointer.\n");
+        return;
+    }
+    s->clipNear = clipNear;
+    s->clipFar = clipFar;
+}
+
 /**
  * Copy the DrawState data.
  */
@@ -90,5 +108,7 @@ void drawstate_copy(DrawState *to, DrawState *from) {
     to->shade = from->shade;
     to->zBufferFlag = from->zBufferFlag;
     to->surfaceCoeff = from->surfaceCoeff;
+    to->clipNear = from->clipNear;
+    to->clipFar = from->clipFar;
     point_copy(&(to->viewer), &(from->viewer));
 }
\ No newline at end of file
@@ -0,0 +1,690 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Implements fractal.h. The subdivision engine is the Mariani-Silver
+ * algorithm: the escape-time count is constant over large connected regions
+ * of the image, so a rectangle whose whole border has one count is filled
+ * with that count without iterating its interior. Otherwise the rectangle is
+ * split in two along its longer side and each half is tried again, down to
+ * thin rectangles that are simply computed pixel by pixel. The image is first
+ * cut into FRACTAL_TILE square tiles that are handed out with parallel_for().
+ *
+ * The progressive engine trades nothing in accuracy for responsiveness: it
+ * computes the same counts as brute force, just coarse samples first, and
+ * every pixel is still iterated exactly once.
+ */
+#include "graphicslib.h"
+#include "fractal.h"
+
+#define FRACTAL_UNKNOWN -1 // Marks a pixel whose count is not known yet
+#define FRACTAL_BATCH (FRACTAL_TILE * FRACTAL_TILE)
+
+static FractalEngine fractal_currentEngine = EngineBrute;
+
+/**
+ * Select the engine image_mandelbrot()/mandelbrot() and image_julia()/julia()
+ * render with. Brute force is the default. Should not be called while a
+ * render is running.
+ */
+void fractal_setEngine(FractalEngine engine) {
+    fractal_currentEngine = engine;
+}
+
+/**
+ * Return the engine currently selected with fractal_setEngine().
+ */
+FractalEngine fractal_engine(void) {
+    return fractal_currentEngine;
+}
+
+typedef struct {
+    int rows, cols;
+    int *counts; // rows * cols iteration counts, FRACTAL_UNKNOWN until set
+    FractalBatch batch;
+    void *arg;
+    int *row, *col, *out; // per-worker batch scratch, FRACTAL_BATCH entries each
+    int *computed; // per-worker number of pixels iterated
+} SubdivideJob;
+
+typedef struct {
+    SubdivideJob *job;
+    int worker;
+    int n; // pixels queued in the batch
+    int *row, *col, *out;
+} SubdivideBatch;
+
+/**
+ * Queue pixel (r, c) for computing unless its count is already known.
+ */
+static void subdivide_queue(SubdivideBatch *b, int r, int c) {
+    if (b->job->counts[r * b->job->cols + c] == FRACTAL_UNKNOWN) {
+        b->row[b->n] = r;
+        b->col[b->n] = c;
+        b->n++;
+    }
+}
+
+/**
+ * Compute every queued pixel with one call to the fractal and store the
+ * results.
+ */
+static void subdivide_flush(SubdivideBatch *b) {
+    SubdivideJob *job = b->job;
+
+    if (b->n > 0) {
+        job->batch(b->row, b->col, b->n, b->worker, b->out, job->arg);
+        for (int k = 0; k < b->n; k++) {
+            job->counts[b->row[k] * job->cols + b->col[k]] = b->out[k];
+        }
+        job->computed[b->worker] += b->n;
+        b->n = 0;
+    }
+}
+
+/**
+ * Resolve the rectangle with top left (r0, c0) and size h x w, whose border
+ * pixels may already be known from the parent rectangle.
+ */
+static void subdivide_rect(SubdivideBatch *b, int r0, int c0, int h, int w) {
+    SubdivideJob *job = b->job;
+    int *counts = job->counts;
+    int cols = job->cols;
+    int r, c, first, uniform;
+
+    // Thin rectangles have little interior to save: compute everything
+    if (h <= FRACTAL_MIN_RECT || w <= FRACTAL_MIN_RECT) {
+        for (r = r0; r < r0 + h; r++) {
+            for (c = c0; c < c0 + w; c++) {
+                subdivide_queue(b, r, c);
+            }
+        }
+        subdivide_flush(b);
+        return;
+    }
+
+    // Compute the border
+    for (c = c0; c < c0 + w; c++) {
+        subdivide_queue(b, r0, c);
+        subdivide_queue(b, r0 + h - 1, c);
+    }
+    for (r = r0 + 1; r < r0 + h - 1; r++) {
+        subdivide_queue(b, r, c0);
+        subdivide_queue(b, r, c0 + w - 1);
+    }
+    subdivide_flush(b);
+
+    // Check whether every border pixel has the same count
+    first = counts[r0 * cols + c0];
+    uniform = 1;
+    for (c = c0; c < c0 + w && uniform; c++) {
+        uniform = counts[r0 * cols + c] == first &&
+                  counts[(r0 + h - 1) * cols + c] == first;
+    }
+    for (r = r0 + 1; r < r0 + h - 1 && uniform; r++) {
+        uniform = counts[r * cols + c0] == first &&
+                  counts[r * cols + c0 + w - 1] == first;
+    }
+
+    if (uniform) {
+        for (r = r0 + 1; r < r0 + h - 1; r++) {
+            for (c = c0 + 1; c < c0 + w - 1; c++) {
+                counts[r * cols + c] = first;
+            }
+        }
+        return;
+    }
+
+    // Split along the longer side; the halves share the dividing line
+    if (w >= h) {
+        int half = w / 2;
+        subdivide_rect(b, r0, c0, h, half + 1);
+        subdivide_rect(b, r0, c0 + half, h, w - half);
+    } else {
+        int half = h / 2;
+        subdivide_rect(b, r0, c0, half + 1, w);
+        subdivide_rect(b, r0 + half, c0, h - half, w);
+    }
+}
+
+static void subdivide_tile(int index, int worker, void *arg) {
+    SubdivideJob *job = arg;
+    int tilesAcross = (job->cols + FRACTAL_TILE - 1) / FRACTAL_TILE;
+    int r0 = (index / tilesAcross) * FRACTAL_TILE;
+    int c0 = (index % tilesAcross) * FRACTAL_TILE;
+    SubdivideBatch b;
+
+    b.job = job;
+    b.worker = worker;
+    b.n = 0;
+    b.row = job->row + (size_t) worker * FRACTAL_BATCH;
+    b.col = job->col + (size_t) worker * FRACTAL_BATCH;
+    b.out = job->out + (size_t) worker * FRACTAL_BATCH;
+
+    subdivide_rect(&b, r0, c0,
+                   job->rows - r0 < FRACTAL_TILE ? job->rows - r0 : FRACTAL_TILE,
+                   job->cols - c0 < FRACTAL_TILE ? job->cols - c0 : FRACTAL_TILE);
+}
+
+/**
+ * Fill the rows x cols array counts with iteration counts using the
+ * Mariani-Silver subdivision engine, calling batch for the pixels that have
+ * to be iterated. Tiles are processed in parallel. Returns the number of
+ * pixels that were actually iterated, or -1 on failure.
+ */
+int fractal_subdivide(int rows, int cols, int *counts, FractalBatch batch,
+                      void *arg) {
+    SubdivideJob job;
+    int threads = parallel_threads();
+    size_t scratch = (size_t) threads * FRACTAL_BATCH;
+    int tiles, computed = 0;
+
+    if (!counts || !batch) {
+        printf("fractal_subdivide(): passed NULL pointer.\n");
+        return -1;
+    }
+    if (rows <= 0 || cols <= 0) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < (size_t) rows * cols; i++) {
+        counts[i] = FRACTAL_UNKNOWN;
+    }
+
+    job.rows = rows;
+    job.cols = cols;
+    job.counts = counts;
+    job.batch = batch;
+    job.arg = arg;
+    job.row = malloc(sizeof(int) * scratch);
+    job.col = malloc(sizeof(int) * scratch);
+    job.out = malloc(sizeof(int) * scratch);
+    job.computed = calloc(threads, sizeof(int));
+    if (!job.row || !job.col || !job.out || !job.computed) {
+        printf("fractal_subdivide(): malloc() failed.\n");
+        free(job.row);
+        free(job.col);
+        free(job.out);
+        free(job.computed);
+        return -1;
+    }
+
+    tiles = ((rows + FRACTAL_TILE - 1) / FRACTAL_TILE) *
+            ((cols + FRACTAL_TILE - 1) / FRACTAL_TILE);
+    parallel_for(tiles, subdivide_tile, &job);
+
+    for (int t = 0; t < threads; t++) {
+        computed += job.computed[t];
+    }
+
+    free(job.row);
+    free(job.col);
+    free(job.out);
+    free(job.computed);
+
+    return computed;
+}
+
+/* Tile cache. Each entry holds the counts of one FRACTAL_TILE square tile of
+the infinite pixel grid with spacing pixel, where grid pixel (r, c) is the
+point (c * pixel, -r * pixel). Entries are keyed on the fractal parameters, the
+exact bits of the pixel size, and the tile position, found through a chained
+hash table and kept in least-recently-used order. Counts rather than colors are
+stored so a view can be recolored without iterating. The cache is disabled
+until given a limit and is not thread safe. */
+#define FRACTAL_CACHE_BUCKETS 1024
+
+typedef struct FractalTileEntry {
+    FractalParams params;
+    double pixel;
+    int tileRow, tileCol; // tile position in FRACTAL_TILE units
+    unsigned long hash;
+    int counts[FRACTAL_TILE * FRACTAL_TILE];
+    struct FractalTileEntry *chain; // next entry in the same bucket
+    struct FractalTileEntry *newer; // LRU neighbours
+    struct FractalTileEntry *older;
+} FractalTileEntry;
+
+static FractalTileEntry *fractalCache_buckets[FRACTAL_CACHE_BUCKETS];
+static FractalTileEntry *fractalCache_newest = NULL;
+static FractalTileEntry *fractalCache_oldest = NULL;
+static size_t fractalCache_bytes = 0;
+static size_t fractalCache_limit = 0;
+
+/**
+ * FNV-1a hash of a tile's key.
+ */
+static unsigned long fractalCache_hash(FractalParams *params, double pixel,
+                                       int tileRow, int tileCol) {
+    unsigned long h = 2166136261UL;
+    double values[3] = {params->a, params->b, pixel};
+    int ints[4] = {params->fractal, params->maxIter, tileRow, tileCol};
+    const unsigned char *bytes = (const unsigned char *) values;
+
+    for (size_t i = 0; i < sizeof(values); i++) {
+        h = (h ^ bytes[i]) * 16777619UL;
+    }
+    bytes = (const unsigned char *) ints;
+    for (size_t i = 0; i < sizeof(ints); i++) {
+        h = (h ^ bytes[i]) * 16777619UL;
+    }
+
+    return h;
+}
+
+/**
+ * Unlink the entry from the LRU list.
+ */
+static void fractalCache_unlink(FractalTileEntry *e) {
+    if (e->newer) {
+        e->newer->older = e->older;
+    } else {
+        fractalCache_newest = e->older;
+    }
+    if (e->older) {
+        e->older->newer = e->newer;
+    } else {
+        fractalCache_oldest = e->newer;
+    }
+    e->newer = NULL;
+    e->older = NULL;
+}
+
+/**
+ * Put the entry at the most recently used end of the LRU list.
+ */
+static void fractalCache_pushNewest(FractalTileEntry *e) {
+    e->newer = NULL;
+    e->older = fractalCache_newest;
+    if (fractalCache_newest) {
+        fractalCache_newest->newer = e;
+    } else {
+        fractalCache_oldest = e;
+    }
+    fractalCache_newest = e;
+}
+
+/**
+ * Remove the entry from the cache and free it.
+ */
+static void fractalCache_remove(FractalTileEntry *e) {
+    FractalTileEntry **link = &fractalCache_buckets[e->hash % FRACTAL_CACHE_BUCKETS];
+
+    while (*link != e) {
+        link = &((*link)->chain);
+    }
+    *link = e->chain;
+    fractalCache_unlink(e);
+    fractalCache_bytes -= sizeof(FractalTileEntry);
+    free(e);
+}
+
+/**
+ * Evict least recently used tiles until the cache fits within its limit.
+ */
+static void fractalCache_trim(void) {
+    while (fractalCache_oldest && fractalCache_bytes > fractalCache_limit) {
+        fractalCache_remove(fractalCache_oldest);
+    }
+}
+
+/**
+ * Return the cached tile with the given key, or NULL.
+ */
+static FractalTileEntry *fractalCache_find(FractalParams *params, double pixel,
+                                           int tileRow, int tileCol,
+                                           unsigned long hash) {
+    FractalTileEntry *e;
+
+    for (e = fractalCache_buckets[hash % FRACTAL_CACHE_BUCKETS]; e; e = e->chain) {
+        if (e->hash == hash && e->tileRow == tileRow && e->tileCol == tileCol &&
+            e->pixel == pixel && e->params.fractal == params->fractal &&
+            e->params.maxIter == params->maxIter && e->params.a == params->a &&
+            e->params.b == params->b) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Return the index of the FRACTAL_TILE cell holding grid coordinate v,
+ * rounding towards negative infinity.
+ */
+static int fractalCache_tileOf(int v) {
+    return v >= 0 ? v / FRACTAL_TILE : -((-v + FRACTAL_TILE - 1) / FRACTAL_TILE);
+}
+
+typedef struct {
+    FractalTileEntry **missing; // tiles to compute
+    FractalBatch batch;
+    void *arg;
+    int *row, *col; // per-worker batch scratch, FRACTAL_BATCH entries each
+} CacheJob;
+
+static void fractalCache_computeTile(int index, int worker, void *arg) {
+    CacheJob *job = arg;
+    FractalTileEntry *e = job->missing[index];
+    int *row = job->row + (size_t) worker * FRACTAL_BATCH;
+    int *col = job->col + (size_t) worker * FRACTAL_BATCH;
+
+    for (int k = 0; k < FRACTAL_BATCH; k++) {
+        row[k] = e->tileRow * FRACTAL_TILE + k / FRACTAL_TILE;
+        col[k] = e->tileCol * FRACTAL_TILE + k % FRACTAL_TILE;
+    }
+    job->batch(row, col, FRACTAL_BATCH, worker, e->counts, job->arg);
+}
+
+/**
+ * Fill the rows x cols array counts for the view whose top left pixel is grid
+ * pixel (row0, col0) of the grid with spacing pixel, so that counts[i][j]
+ * belongs to the point ((col0 + j) * pixel, -(row0 + i) * pixel). Tiles found
+ * in the cache are copied; the rest are computed in parallel by calling batch
+ * with grid (not view) coordinates, and then cached. Returns the number of
+ * tiles computed, or -1 on failure (including when the cache is disabled).
+ */
+int fractal_cached(int rows, int cols, int row0, int col0, double pixel,
+                   FractalParams *params, int *counts, FractalBatch batch,
+                   void *arg) {
+    FractalTileEntry **tiles;
+    CacheJob job;
+    int tr0, tc0, nRows, nCols, nMissing = 0, failed = 0;
+    size_t scratch = (size_t) parallel_threads() * FRACTAL_BATCH;
+
+    if (!params || !counts || !batch) {
+        printf("fractal_cached(): passed NULL pointer.\n");
+        return -1;
+    }
+    if (fractalCache_limit == 0) {
+        return -1;
+    }
+    if (rows <= 0 || cols <= 0) {
+        return 0;
+    }
+
+    tr0 = fractalCache_tileOf(row0);
+    tc0 = fractalCache_tileOf(col0);
+    nRows = fractalCache_tileOf(row0 + rows - 1) - tr0 + 1;
+    nCols = fractalCache_tileOf(col0 + cols - 1) - tc0 + 1;
+
+    tiles = malloc(sizeof(FractalTileEntry *) * nRows * nCols * 2);
+    job.row = malloc(sizeof(int) * scratch);
+    job.col = malloc(sizeof(int) * scratch);
+    if (!tiles || !job.row || !job.col) {
+        printf("fractal_cached(): malloc() failed.\n");
+        free(tiles);
+        free(job.row);
+        free(job.col);
+        return -1;
+    }
+    job.missing = tiles + nRows * nCols;
+    job.batch = batch;
+    job.arg = arg;
+
+    // Look up every tile the view touches, allocating the ones not cached
+    for (int t = 0; t < nRows * nCols; t++) {
+        int tileRow = tr0 + t / nCols, tileCol = tc0 + t % nCols;
+        unsigned long hash = fractalCache_hash(params, pixel, tileRow, tileCol);
+        FractalTileEntry *e = fractalCache_find(params, pixel, tileRow, tileCol,
+                                                hash);
+
+        if (e) {
+            fractalCache_unlink(e);
+            fractalCache_pushNewest(e);
+        } else {
+            e = malloc(sizeof(FractalTileEntry));
+            if (!e) {
+                printf("fractal_cached(): malloc() failed.\n");
+                failed = 1;
+                break;
+            }
+            e->params = *params;
+            e->pixel = pixel;
+            e->tileRow = tileRow;
+            e->tileCol = tileCol;
+            e->hash = hash;
+            job.missing[nMissing++] = e;
+        }
+        tiles[t] = e;
+    }
+
+    if (failed) {
+        for (int k = 0; k < nMissing; k++) {
+            free(job.missing[k]);
+        }
+        free(tiles);
+        free(job.row);
+        free(job.col);
+        return -1;
+    }
+
+    parallel_for(nMissing, fractalCache_computeTile, &job);
+
+    // Copy the part of each tile inside the view
+    for (int i = 0; i < rows; i++) {
+        int r = row0 + i;
+        int tr = fractalCache_tileOf(r) - tr0;
+        int within = r - (tr + tr0) * FRACTAL_TILE;
+
+        for (int j = 0; j < cols; j++) {
+            int c = col0 + j;
+            int tc = fractalCache_tileOf(c) - tc0;
+            counts[i * cols + j] = tiles[tr * nCols + tc]->counts[
+                within * FRACTAL_TILE + c - (tc + tc0) * FRACTAL_TILE];
+        }
+    }
+
+    // Cache the new tiles, then evict down to the limit
+    for (int k = 0; k < nMissing; k++) {
+        FractalTileEntry *e = job.missing[k];
+        e->chain = fractalCache_buckets[e->hash % FRACTAL_CACHE_BUCKETS];
+        fractalCache_buckets[e->hash % FRACTAL_CACHE_BUCKETS] = e;
+        fractalCache_pushNewest(e);
+        fractalCache_bytes += sizeof(FractalTileEntry);
+    }
+    fractalCache_trim();
+
+    free(tiles);
+    free(job.row);
+    free(job.col);
+
+    return nMissing;
+}
+
+/**
+ * Set the most memory, in bytes, the tile cache may hold, evicting the least
+ * recently used tiles if it is already over the new limit. The limit starts at
+ * 0, which disables the cache.
+ */
+void fractal_setCacheLimit(size_t bytes) {
+    fractalCache_limit = bytes;
+    fractalCache_trim();
+}
+
+/**
+ * Return the tile cache's memory limit in bytes; 0 means it is disabled.
+ */
+size_t fractal_cacheLimit(void) {
+    return fractalCache_limit;
+}
+
+/**
+ * Empty the tile cache.
+ */
+void fractal_clearCache(void) {
+    while (fractalCache_oldest) {
+        fractalCache_remove(fractalCache_oldest);
+    }
+}
+
+/**
+ * Reset the token so it can be handed to a new render.
+ */
+void fractal_cancelInit(FractalCancel *token) {
+    if (!token) {
+        printf("fractal_cancelInit(): passed NULL pointer.\n");
+        return;
+    }
+
+    atomic_init(&token->cancelled, 0);
+}
+
+/**
+ * Ask every render holding the token to stop. Safe to call from any thread;
+ * the render returns FRACTAL_CANCELLED once its workers finish the batch they
+ * are on.
+ */
+void fractal_cancel(FractalCancel *token) {
+    if (!token) {
+        printf("fractal_cancel(): passed NULL pointer.\n");
+        return;
+    }
+
+    atomic_store(&token->cancelled, 1);
+}
+
+/**
+ * Return 1 if fractal_cancel() has been called on the token, else 0. A NULL
+ * token is never cancelled.
+ */
+int fractal_cancelled(FractalCancel *token) {
+    return token && atomic_load(&token->cancelled);
+}
+
+typedef struct {
+    int rows, cols;
+    int *counts;
+    FractalBatch batch;
+    void *arg;
+    FractalCancel *cancel;
+    int step; // pixel spacing of the current pass
+    int *row, *col, *out; // per-worker batch scratch, FRACTAL_BATCH entries each
+} ProgressiveJob;
+
+/**
+ * Return 1 if pixel (r, c) was computed by a pass of spacing step or coarser.
+ */
+static int progressive_known(int r, int c, int step) {
+    return r % step == 0 && c % step == 0;
+}
+
+/**
+ * Compute the n pixels queued on row r and store their counts.
+ */
+static void progressive_flush(ProgressiveJob *job, int worker, int r,
+                              int *row, int *col, int *out, int n) {
+    job->batch(row, col, n, worker, out, job->arg);
+    for (int k = 0; k < n; k++) {
+        job->counts[r * job->cols + col[k]] = out[k];
+    }
+}
+
+/**
+ * Compute the pixels of image row index * step that belong to the current
+ * pass, skipping the samples earlier passes already computed.
+ */
+static void progressive_row(int index, int worker, void *arg) {
+    ProgressiveJob *job = arg;
+    int r = index * job->step;
+    int *row = job->row + (size_t) worker * FRACTAL_BATCH;
+    int *col = job->col + (size_t) worker * FRACTAL_BATCH;
+    int *out = job->out + (size_t) worker * FRACTAL_BATCH;
+    int n = 0;
+
+    if (fractal_cancelled(job->cancel)) {
+        return;
+    }
+
+    for (int c = 0; c < job->cols; c += job->step) {
+        if (job->step < FRACTAL_COARSE_STEP &&
+            progressive_known(r, c, job->step * 2)) {
+            continue;
+        }
+        row[n] = r;
+        col[n] = c;
+        if (++n == FRACTAL_BATCH) {
+            progressive_flush(job, worker, r, row, col, out, n);
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        progressive_flush(job, worker, r, row, col, out, n);
+    }
+}
+
+/**
+ * Give every pixel of row r not yet computed the count of the sample at the
+ * top left of its step x step block.
+ */
+static void progressive_fill(int r, int worker, void *arg) {
+    ProgressiveJob *job = arg;
+    int *counts = job->counts;
+    int sr = r - r % job->step;
+
+    for (int c = 0; c < job->cols; c++) {
+        if (!progressive_known(r, c, job->step)) {
+            counts[r * job->cols + c] = counts[sr * job->cols + c - c % job->step];
+        }
+    }
+}
+
+/**
+ * Fill the rows x cols array counts progressively: a first pass computes every
+ * FRACTAL_COARSE_STEP-th pixel in each direction, and each following pass
+ * halves the spacing, computing only the pixels earlier passes did not. After
+ * every pass the remaining pixels are filled from the samples so far and pass
+ * (if not NULL) is called with the spacing. Rows of each pass are computed in
+ * parallel. If cancel (which may be NULL) is cancelled, the render stops as
+ * soon as the running batches finish and returns FRACTAL_CANCELLED without
+ * calling pass again; otherwise it returns 0, or -1 on failure.
+ */
+int fractal_progressive(int rows, int cols, int *counts, FractalBatch batch,
+                        FractalPass pass, void *arg, FractalCancel *cancel) {
+    ProgressiveJob job;
+    size_t scratch = (size_t) parallel_threads() * FRACTAL_BATCH;
+    int result = 0;
+
+    if (!counts || !batch) {
+        printf("fractal_progressive(): passed NULL pointer.\n");
+        return -1;
+    }
+    if (rows <= 0 || cols <= 0) {
+        return 0;
+    }
+
+    job.rows = rows;
+    job.cols = cols;
+    job.counts = counts;
+    job.batch = batch;
+    job.arg = arg;
+    job.cancel = cancel;
+    job.row = malloc(sizeof(int) * scratch);
+    job.col = malloc(sizeof(int) * scratch);
+    job.out = malloc(sizeof(int) * scratch);
+    if (!job.row || !job.col || !job.out) {
+        printf("fractal_progressive(): malloc() failed.\n");
+        free(job.row);
+        free(job.col);
+        free(job.out);
+        return -1;
+    }
+
+    for (job.step = FRACTAL_COARSE_STEP; job.step >= 1; job.step /= 2) {
+        parallel_for((rows + job.step - 1) / job.step, progressive_row, &job);
+        if (fractal_cancelled(cancel)) {
+            result = FRACTAL_CANCELLED;
+            break;
+        }
+        if (job.step > 1) {
+            parallel_for(rows, progressive_fill, &job);
+        }
+        if (pass) {
+            pass(job.step, arg);
+        }
+    }
+
+    free(job.row);
+    free(job.col);
+    free(job.out);
+
+    return result;
+}
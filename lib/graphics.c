@@ -575,6 +575,24 @@ void line_draw(Line *l, Image *src, Color c) {
 }
 
 
+/**
+ * Draw the numV - 1 connected segments of the vertex list vlist in color c,
+ * reusing a single Line record. This is the batch entry point for code that
+ * generates many vertices at once (e.g. flattened curves), and unlike
+ * polyline_draw() it sets the z-buffer flag explicitly for every segment.
+ */
+void line_drawStrip(Point *vlist, int numV, int zBuffer, Image *src, Color c) {
+    Line l;
+
+    l.zBuffer = zBuffer;
+    for (int i = 1; i < numV; i++) {
+        l.a = vlist[i - 1];
+        l.b = vlist[i];
+        line_draw(&l, src, c);
+    }
+}
+
+
 /* CIRCLE PRIMITIVES */
 
 /**
@@ -699,12 +717,158 @@ void ellipse_set(Ellipse *e, Point tc, double ta, double tb) {
     e->a = 0.0; // Aligned to major axis
 }
 
+/**
+ * Set the angle (in radians) of the ellipse's ra axis relative to the image
+ * x-axis. Since image rows grow downwards, positive angles turn the ellipse
+ * clockwise on screen. An angle of 0.0 uses the axis-aligned Bresenham code.
+ */
+void ellipse_setAngle(Ellipse *e, double ta) {
+    e->a = ta;
+}
+
+/* Scanline state for rotated ellipses. Relative to its center, the ellipse is
+the implicit conic A*x^2 + B*x*y + C*y^2 = F, so on each scanline the span
+endpoints are the roots of a quadratic in x. The discriminant of that quadratic
+is itself quadratic in y, so it is stepped with forward differences and the
+only per-scanline cost is a single sqrt - the trig happens once per ellipse. */
+typedef struct {
+    double twoA; // 2A, the denominator of the quadratic formula
+    double mid, dMid; // Center of the current span and its change per row
+    double disc, dDisc, ddDisc; // Discriminant and its forward differences
+    int row; // Current scanline
+    int rowEnd; // Last scanline the ellipse can touch
+} EllipseScan;
+
+/**
+ * Compute the conic coefficients for e and position the scan on its top row.
+ */
+static void ellipseScan_init(EllipseScan *s, Ellipse *e) {
+    double cth = cos(e->a);
+    double sth = sin(e->a);
+    double ra2 = e->ra * e->ra;
+    double rb2 = e->rb * e->rb;
+
+    // Coefficients scaled by ra^2 * rb^2 to keep them well away from zero
+    double A = rb2 * cth * cth + ra2 * sth * sth;
+    double B = 2.0 * sth * cth * (rb2 - ra2);
+    double C = rb2 * sth * sth + ra2 * cth * cth;
+    double F = ra2 * rb2;
+    double K = B * B - 4.0 * A * C; // Always negative for a real ellipse
+    double yExtent = sqrt(-4.0 * A * F / K);
+    double dy;
+
+    // Scanlines pass through pixel centers at row + 0.5
+    s->row = (int) ceil(e->c.val[1] - yExtent - 0.5);
+    s->rowEnd = (int) floor(e->c.val[1] + yExtent - 0.5);
+    dy = s->row + 0.5 - e->c.val[1];
+
+    s->twoA = 2.0 * A;
+    s->mid = e->c.val[0] - B * dy / s->twoA;
+    s->dMid = -B / s->twoA;
+    s->disc = K * dy * dy + 4.0 * A * F;
+    s->dDisc = K * (2.0 * dy + 1.0);
+    s->ddDisc = 2.0 * K;
+}
+
+/**
+ * Compute the pixel span [*xl, *xr] covered by the current scanline and advance
+ * to the next one. Returns 0 if the scanline misses every pixel center.
+ */
+static int ellipseScan_next(EllipseScan *s, int *xl, int *xr) {
+    double half;
+    int covered = 0;
+
+    if (s->disc >= 0.0) {
+        half = sqrt(s->disc) / s->twoA;
+        *xl = (int) ceil(s->mid - half - 0.5);
+        *xr = (int) floor(s->mid + half - 0.5);
+        covered = *xl <= *xr;
+    }
+
+    s->row++;
+    s->mid += s->dMid;
+    s->disc += s->dDisc;
+    s->dDisc += s->ddDisc;
+    return covered;
+}
+
+/**
+ * Color pixels x0 through x1 (inclusive) of the given row, clipped to src.
+ */
+static void ellipse_span(Image *src, int row, int x0, int x1, Color p) {
+    FPixel *pix;
+
+    if (row < 0 || row >= src->rows) {
+        return;
+    }
+    x0 = x0 < 0 ? 0 : x0;
+    x1 = x1 >= src->cols ? src->cols - 1 : x1;
+
+    pix = src->data + (long) row * src->cols;
+    for (int x = x0; x <= x1; x++) {
+        pix[x].rgb[0] = p.c[0];
+        pix[x].rgb[1] = p.c[1];
+        pix[x].rgb[2] = p.c[2];
+    }
+}
+
+/**
+ * Draw a rotated ellipse, outlined or filled, by walking its scanline spans.
+ * The outline on each row runs from the span endpoint to just short of the
+ * endpoint of whichever neighbouring row reaches farther in, so that the
+ * boundary stays 8-connected where it is nearly horizontal.
+ */
+static void ellipse_drawRotated(Ellipse *e, Image *src, Color p, int fill) {
+    EllipseScan s;
+    int row, l[3], r[3], on[3];
+
+    ellipseScan_init(&s, e);
+    if (s.row > s.rowEnd) {
+        return;
+    }
+
+    // Keep a sliding window of (previous, current, next) spans:
+    on[0] = 0;
+    row = s.row;
+    on[1] = ellipseScan_next(&s, &l[1], &r[1]);
+
+    for (; row <= s.rowEnd; row++) {
+        on[2] = row < s.rowEnd ? ellipseScan_next(&s, &l[2], &r[2]) : 0;
+
+        if (on[1] && fill) {
+            ellipse_span(src, row, l[1], r[1], p);
+        } else if (on[1]) {
+            if (!on[0] || !on[2]) {
+                // Top or bottom of the ellipse - the whole span is boundary
+                ellipse_span(src, row, l[1], r[1], p);
+            } else {
+                int inL = (l[0] > l[2] ? l[0] : l[2]) - 1;
+                int inR = (r[0] < r[2] ? r[0] : r[2]) + 1;
+                // Each run stays within this row's span
+                inL = inL < l[1] ? l[1] : (inL > r[1] ? r[1] : inL);
+                inR = inR > r[1] ? r[1] : (inR < l[1] ? l[1] : inR);
+                ellipse_span(src, row, l[1], inL, p);
+                ellipse_span(src, row, inR, r[1], p);
+            }
+        }
+
+        // Slide the window down one row:
+        l[0] = l[1]; r[0] = r[1]; on[0] = on[1];
+        l[1] = l[2]; r[1] = r[2]; on[1] = on[2];
+    }
+}
+
 /**
  * Draw an ellipse using Bresenham's Ellipse algorithm. Adapted from pseudocode
  * in lecture notes provided by Prof. Bruce Maxwell at the Roux Institute, Sept.
- * 2021.
+ * 2021. Rotated ellipses (nonzero angle) are drawn from their scanline spans.
  */
 void ellipse_draw(Ellipse *e, Image *src, Color p) {
+    if (e->a != 0.0) {
+        ellipse_drawRotated(e, src, p, 0);
+        return;
+    }
+
     // Initialize the first point
     int x = -1;
     int y = -e->rb;
@@ -770,6 +934,12 @@ void ellipse_drawFill(Ellipse *e, Image *src, Color p) {
     Point a;
     Point b;
     Line l;
+
+    if (e->a != 0.0) {
+        ellipse_drawRotated(e, src, p, 1);
+        return;
+    }
+
     // Initialize the first point
     int x = -1;
     int y = -e->rb;
@@ -40,6 +40,9 @@ void image_free(Image *src) {
     free(src->depth);
     free(src->alpha);
     free(src->data);
+    free(src->normal);
+    free(src->material);
+    free(src->materials);
     free(src);
     return;
 }
@@ -56,6 +59,11 @@ void image_init(Image *src) {
     src->alpha = NULL;
     src->depth = NULL;
     src->data = NULL;
+    src->normal = NULL;
+    src->material = NULL;
+    src->materials = NULL;
+    src->nMaterials = 0;
+    src->maxMaterials = 0;
     return;
 }
 
@@ -114,10 +122,18 @@ void image_dealloc(Image *src) {
     free(src->depth);
     free(src->data);
     free(src->alpha);
+    free(src->normal);
+    free(src->material);
+    free(src->materials);
 
     src->depth = NULL;
     src->alpha = NULL;
     src->data = NULL;
+    src->normal = NULL;
+    src->material = NULL;
+    src->materials = NULL;
+    src->nMaterials = 0;
+    src->maxMaterials = 0;
 
     src->maxval = 1.0;
     src->rows = 0;
@@ -126,6 +142,102 @@ void image_dealloc(Image *src) {
 }
 
 
+/**
+ * Allocates the G-buffer used for deferred shading: a normal and a material
+ * id for every pixel, which are drawn along with the depth when the
+ * DrawState's shade method is ShadePhong. The G-buffer starts out cleared.
+ * Does nothing if the image already has one.
+ *
+ * returns 0 if the operation is successful. Otherwise, returns -1.
+ */
+int image_allocGBuffer(Image *src) {
+    if (!src) {
+        printf("image_allocGBuffer(): passed NULL pointer.\n");
+        return -1;
+    }
+    if (src->material) {
+        return 0;
+    }
+
+    src->normal = malloc(sizeof(float) * 3 * src->rows * src->cols);
+    src->material = malloc(sizeof(int) * src->rows * src->cols);
+    if (!src->normal || !src->material) {
+        printf("image_allocGBuffer(): malloc failed.\n");
+        free(src->normal);
+        free(src->material);
+        src->normal = NULL;
+        src->material = NULL;
+        return -1;
+    }
+
+    image_clearGBuffer(src);
+    return 0;
+}
+
+
+/**
+ * Marks every pixel of the G-buffer as empty and forgets its materials. The
+ * depth and colors of the image are left as they are.
+ */
+void image_clearGBuffer(Image *src) {
+    if (!src) {
+        printf("image_clearGBuffer(): passed NULL pointer.\n");
+        return;
+    }
+    if (!src->material) {
+        return;
+    }
+
+    for (int i = 0; i < src->rows * src->cols; i++) {
+        src->material[i] = -1;
+    }
+    src->nMaterials = 0;
+}
+
+
+/**
+ * Returns the G-buffer id of the material with the given reflectance, adding
+ * it to the image's materials if it isn't there yet, or -1 on failure.
+ * Consecutive polygons usually share a material, so the search starts with
+ * the most recently added one.
+ */
+int image_material(Image *src, Color *body, Color *surface, float sharpness,
+                   int oneSided) {
+    Material m;
+
+    if (!src || !body || !surface) {
+        printf("image_material(): passed NULL pointer.\n");
+        return -1;
+    }
+
+    memset(&m, 0, sizeof(Material));
+    color_copy(&m.body, body);
+    color_copy(&m.surface, surface);
+    m.sharpness = sharpness;
+    m.oneSided = oneSided;
+
+    for (int i = src->nMaterials - 1; i >= 0; i--) {
+        if (!memcmp(&src->materials[i], &m, sizeof(Material))) {
+            return i;
+        }
+    }
+
+    if (src->nMaterials == src->maxMaterials) {
+        int max = src->maxMaterials ? src->maxMaterials * 2 : 16;
+        Material *grown = realloc(src->materials, sizeof(Material) * max);
+        if (!grown) {
+            printf("image_material(): realloc failed.\n");
+            return -1;
+        }
+        src->materials = grown;
+        src->maxMaterials = max;
+    }
+
+    src->materials[src->nMaterials] = m;
+    return src->nMaterials++;
+}
+
+
 
 /* I/O Functions */
 Image *image_read(char *filename) {
@@ -340,7 +452,7 @@ void image_setz(Image *src, int r, int c, float val) {
 
 /**
  * Resets every pixel to a default value (e.g. Black, alpha value of 1.0, z 
- * value of 1.0).
+ * value of 1.0), and empties the G-buffer if the image has one.
  */
 void image_reset(Image *src) {
     for (int i = 0; i < src->rows * src->cols; i++) {
@@ -352,6 +464,7 @@ void image_reset(Image *src) {
                 src->data[i].rgb[j] = 0.0;
             }
         }
+    image_clearGBuffer(src);
     return;
 }
 
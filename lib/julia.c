@@ -26,24 +26,296 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <limits.h>
 #include "graphicslib.h"
 
 #define ITERATIONS 10000 // Num of iterations to run of the dynamic system
-#define CX 0.7454054; // constant component of c in the julia set equation
-#define CY 0.1130063; // i-component of c in the julia set equation
+#define CX 0.7454054 // constant component of c in the julia set equation
+#define CY 0.1130063 // i-component of c in the julia set equation
+
+/**
+ * Iterate z = z^2 - c from the start value z = (x, y) and return the
+ * iteration on which |z| first exceeds 2, or maxIter - 1 if it never does.
+ * If last is not NULL it receives the final z.
+ */
+static int julia_escape(float x, float y, float cx, float cy, int maxIter,
+                        float *last) {
+    float x_temp, y_temp;
+    int n;
+
+    for (n = 0; n < maxIter; n++) {
+        // iterate the julia equation
+        // First, square z:
+        // rule for multiplying n in C: (a+bi)(c+di) = (ac-bd)+(ad+bc)i
+        // We have (x+yi)(x+yi) = (xx-yy)+(xy+yx)i
+        x_temp = (x * x) - (y * y);
+        y_temp = (x * y) + (y * x);
+
+        // Then, subtract c:
+        x = x_temp - cx;
+        y = y_temp - cy;
+
+        // if the length of z is greater than 2.0 (|z|^2 > 4, without sqrt)
+        if (x * x + y * y > 4.0f) {
+            break;
+        }
+    }
+
+    if (last) {
+        last[0] = x;
+        last[1] = y;
+    }
+    if (n < maxIter) {
+        return n;
+    }
+    return maxIter > 0 ? maxIter - 1 : 0;
+}
+
+/**
+ * As julia_escape(), but c is subtracted in double precision before rounding
+ * back to float, which is how image_julia() has always used CX and CY.
+ */
+static int julia_escapeDouble(float x, float y, double cx, double cy,
+                              int maxIter, float *last) {
+    float x_temp, y_temp;
+    int n;
+
+    for (n = 0; n < maxIter; n++) {
+        x_temp = (x * x) - (y * y);
+        y_temp = (x * y) + (y * x);
+        x = x_temp - cx;
+        y = y_temp - cy;
+
+        if (x * x + y * y > 4.0f) {
+            break;
+        }
+    }
+
+    if (last) {
+        last[0] = x;
+        last[1] = y;
+    }
+    if (n < maxIter) {
+        return n;
+    }
+    return maxIter > 0 ? maxIter - 1 : 0;
+}
+
+/* Rows are rendered in parallel, one row per work item, since interior rows
+can cost thousands of times more than rows that escape immediately. */
+typedef struct {
+    Image *im;
+    float x0, y1; // complex coordinates of the top left pixel
+    float sx, sy; // size of a pixel in the complex plane
+    double cx, cy; // the constant c
+    int doubleC; // subtract c in double precision (1) or in float (0)
+    int channel; // channel receiving 1 / log(iterations)
+    int *iters; // whole-image iteration counts (subdivision/progressive only)
+    FractalProgress progress; // progressive renders only
+    void *progressArg;
+    Palette *palette; // maps counts to colors
+    IterBuffer *buffer; // receives the counts instead of the image, if set
+    float *frac; // whole-image count fractions (smooth counts only)
+} JuliaJob;
+
+static Palette *julia_palettes[3]; // log palettes by channel, built on first use
+
+/**
+ * Return the log palette writing 1 / log(iterations) to channel, or NULL if
+ * it cannot be built.
+ */
+static Palette *julia_palette(int channel) {
+    if (!julia_palettes[channel]) {
+        julia_palettes[channel] = palette_createLog(ITERATIONS, channel);
+    }
+    return julia_palettes[channel];
+}
+
+/**
+ * Return the iteration count of pixel (i, j), storing its final z in last if
+ * that is not NULL.
+ */
+static int julia_pixel(JuliaJob *job, int i, int j, float *last) {
+    // calculate (x, y) given (i, j)
+    // this corresponds to the initial start value in the Julia equation
+    float x = job->sx * j + job->x0;
+    float y = -job->sy * i + job->y1;
+
+    if (job->doubleC) {
+        return julia_escapeDouble(x, y, job->cx, job->cy, ITERATIONS, last);
+    }
+    return julia_escape(x, y, job->cx, job->cy, ITERATIONS, last);
+}
+
+/**
+ * Color pixel (i, j) from its iteration count, looking up log(iterations) and
+ * 1 / log(iterations) in the job's palette.
+ */
+static void julia_color(JuliaJob *job, int i, int j, int numIters) {
+    const FPixel *color = &job->palette->lut[numIters];
+
+    image_setc(job->im, i, j, 0, color->rgb[0]);
+    image_setc(job->im, i, j, job->channel, color->rgb[job->channel]);
+}
+
+static void julia_renderRow(int i, int worker, void *arg) {
+    JuliaJob *job = arg;
+
+    for (int j = 0; j < job->im->cols; j++) {
+        julia_color(job, i, j, julia_pixel(job, i, j, NULL));
+    }
+}
+
+/**
+ * FractalBatch for the subdivision engine.
+ */
+static void julia_batch(const int *row, const int *col, int n, int worker,
+                        int *counts, void *arg) {
+    for (int k = 0; k < n; k++) {
+        counts[k] = julia_pixel(arg, row[k], col[k], NULL);
+    }
+}
+
+static void julia_colorIters(int i, int worker, void *arg) {
+    JuliaJob *job = arg;
+    int *counts = job->iters + (size_t) i * job->im->cols;
+
+    for (int j = 0; j < job->im->cols; j++) {
+        julia_color(job, i, j, counts[j]);
+    }
+}
+
+/**
+ * Set up job to render the set for the constant c into im, where pixel (i, j)
+ * starts at (sx * j + x0, -sy * i + y1). Returns 0, or -1 if the palette for
+ * channel cannot be built.
+ */
+static int julia_jobInit(JuliaJob *job, Image *im, float x0, float y1, float sx,
+                         float sy, double cx, double cy, int doubleC,
+                         int channel) {
+    job->im = im;
+    job->x0 = x0;
+    job->y1 = y1;
+    job->sx = sx;
+    job->sy = sy;
+    job->cx = cx;
+    job->cy = cy;
+    job->doubleC = doubleC;
+    job->channel = channel;
+    job->iters = NULL;
+    job->progress = NULL;
+    job->progressArg = NULL;
+    job->buffer = NULL;
+    job->frac = NULL;
+    job->palette = julia_palette(channel);
+
+    return job->palette ? 0 : -1;
+}
+
+/**
+ * FractalPass for progressive renders: color the preview and hand it on.
+ */
+static void julia_pass(int step, void *arg) {
+    JuliaJob *job = arg;
+
+    parallel_for(job->im->rows, julia_colorIters, job);
+    if (job->progress) {
+        job->progress(job->im, step, job->progressArg);
+    }
+}
+
+/**
+ * Render the set for the constant c into every pixel of im, where pixel
+ * (i, j) starts at (sx * j + x0, -sy * i + y1), using the engine chosen with
+ * fractal_setEngine(), or the progressive engine if progressive is set. The
+ * work is spread over threads with parallel_for(). Returns 0, or
+ * FRACTAL_CANCELLED or -1 as fractal_progressive() does.
+ */
+static int julia_render(Image *im, float x0, float y1, float sx, float sy,
+                        double cx, double cy, int doubleC, int channel,
+                        int progressive, FractalProgress progress, void *arg,
+                        FractalCancel *cancel) {
+    JuliaJob job;
+    int result = -1;
+
+    if (julia_jobInit(&job, im, x0, y1, sx, sy, cx, cy, doubleC, channel)) {
+        return -1;
+    }
+    job.progress = progress;
+    job.progressArg = arg;
+
+    if (!progressive && fractal_engine() != EngineSubdivide) {
+        parallel_for(im->rows, julia_renderRow, &job);
+        return 0;
+    }
+
+    job.iters = malloc(sizeof(int) * im->rows * im->cols);
+    if (!job.iters) {
+        printf("julia_render(): malloc() failed.\n");
+        return -1;
+    }
+    if (progressive) {
+        result = fractal_progressive(im->rows, im->cols, job.iters, julia_batch,
+                                     julia_pass, &job, cancel);
+    } else if (fractal_subdivide(im->rows, im->cols, job.iters, julia_batch,
+                                 &job) >= 0) {
+        parallel_for(im->rows, julia_colorIters, &job);
+        result = 0;
+    }
+    free(job.iters);
+
+    return result;
+}
+
+/**
+ * Render im for the float constant (cx, cy) from the fractal tile cache,
+ * snapping the view to the grid of pixel-sized steps so tiles line up between
+ * pans. Pixel (i, j) starts at the grid point nearest
+ * (pixel * j + x0, -pixel * i + y1). Returns -1, leaving the image untouched,
+ * if the cache is disabled or the view is too far from the origin to be
+ * addressed on the grid.
+ */
+static int julia_renderCached(Image *im, float x0, float y1, float pixel,
+                              float cx, float cy) {
+    JuliaJob job;
+    FractalParams params = {FRACTAL_JULIA, ITERATIONS, cx, cy};
+    double col0 = floor(x0 / pixel + 0.5), row0 = floor(-y1 / pixel + 0.5);
+    int result = -1;
+
+    if (fractal_cacheLimit() == 0 || !(pixel > 0.0) ||
+        fabs(col0) > INT_MAX / 2 - im->cols || fabs(row0) > INT_MAX / 2 - im->rows) {
+        return -1;
+    }
+
+    // Batches arrive in grid coordinates
+    if (julia_jobInit(&job, im, 0.0, 0.0, pixel, pixel, cx, cy, 0, 2)) {
+        return -1;
+    }
+    job.iters = malloc(sizeof(int) * im->rows * im->cols);
+    if (!job.iters) {
+        printf("julia_renderCached(): malloc() failed.\n");
+        return -1;
+    }
+    if (fractal_cached(im->rows, im->cols, (int) row0, (int) col0, pixel,
+                       &params, job.iters, julia_batch, &job) >= 0) {
+        parallel_for(im->rows, julia_colorIters, &job);
+        result = 0;
+    }
+    free(job.iters);
+
+    return result;
+}
 
 /**
  * "Simple" version of julia(). Allows the user to specify the coordinates
  * (x0, y0) (x1, y1) defining a rectangle in the complex plane, and a number of
  * rows to render in the output image. Then, it creates and returns an Image
- * object with the Julia set rendered.
+ * object with the Julia set rendered. Rows are computed in parallel.
  */
 Image *image_julia(float x0, float y0, float x1, float y1, int rows) {
     Image *im;
     int cols;
-    float sCols, sRows, x, y, x_temp, y_temp;
-    int i, j, n;
-    int numIters;
+    float sCols, sRows;
 
     // calculate the number of columns 
     cols = ((x1 - x0) * rows) / (y1 - y0);
@@ -55,43 +327,9 @@ Image *image_julia(float x0, float y0, float x1, float y1, int rows) {
     sCols = (x1 - x0) / cols;
     sRows = (y1 - y0) / rows;
 
-    // for each pixel in the image (i, j)
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            // calculate (x, y) given (i, j)
-            // this corresponds to the initial start value in the Julia equation
-            x = sCols * j + x0;
-            y = -sRows * i + y1;
-
-            // for some number of iterations up to N (e.g. 100)
-            for (n = 0; n < ITERATIONS; n++) {
-                // iterate the julia equation
-                // First, square z:
-                // rule for multiplying n in C: (a+bi)(c+di) = (ac-bd)+(ad+bc)i
-                // We have (x+yi)(x+yi) = (xx-yy)+(xy+yx)i
-                x_temp = (x * x) - (y * y);
-                y_temp = (x * y) + (y * x);
-                x = x_temp;
-                y = y_temp;
-
-                // Then, subtract c:
-                x = x - CX;
-                y = y - CY;
-
-                // if the length of z is greater than 2.0,
-                if (sqrt(x * x + y * y) > 2) {
-                    numIters = n;
-                    break;
-                }
+    // compute every pixel (i, j), a row at a time
+    julia_render(im, x0, y1, sCols, sRows, CX, CY, 1, 1, 0, NULL, NULL, NULL);
 
-                numIters = n;
-            }
-            // color pixel (i, j)
-            image_setc(im, i, j, 0, log((double) numIters));
-            image_setc(im, i, j, 1, 1.0 / log(((double) numIters)));
-        }
-    }
-    // return the image
     return(im);
 }
 
@@ -100,17 +338,14 @@ Image *image_julia(float x0, float y0, float x1, float y1, int rows) {
  * a rectangle in the complex plane, and an Image object in which to render. 
  * Then, it creates and returns an Image object with the Julia set rendered in
  * for the corresponding rectangle at the depth specified in the ITERATIONS
- * variable defined at the top of this file.
+ * variable defined at the top of this file. With the fractal tile cache turned
+ * on (fractal_setCacheLimit()), panning only computes newly exposed tiles.
  */
 void julia(Image *im, float x0, float y0, float dx) {
     image_reset(im);
     // Grab rows and cols from the image:
     int cols = im->cols;
     int rows = im->rows;
-    
-    float x, y, cx, cy, x_temp, y_temp;
-    int i, j, n;
-    int numIters;
 
     // Compute pixel width
     float pixelwidth = dx / cols;
@@ -121,45 +356,271 @@ void julia(Image *im, float x0, float y0, float dx) {
     // Compute y1
     float y1 = y0 + height;
 
-    // for each pixel in the image (i, j)
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            // calculate (x, y) given (i, j)
-            // this corresponds to the initial start value in the Julia equation
-            x = pixelwidth * j + x0;
-            y = -pixelwidth * i + y1;
-
-            // Set C:
-            cx = 0.7454054; 
-            cy = 0.1130063;
-
-            // for some number of iterations up to N (e.g. 100)
-            for (n = 0; n < ITERATIONS; n++) {
-                // iterate the julia equation
-                // First, square z:
-                // rule for multiplying n in C: (a+bi)(c+di) = (ac-bd)+(ad+bc)i
-                // We have (x+yi)(x+yi) = (xx-yy)+(xy+yx)i
-                x_temp = (x * x) - (y * y);
-                y_temp = (x * y) + (y * x);
-                x = x_temp;
-                y = y_temp;
-
-                // Then, subtract c:
-                x = x - cx;
-                y = y - cy;
-
-                // if the length of z is greater than 2.0,
-                if (sqrt(x * x + y * y) > 2) {
-                    numIters = n;
-                    break;
+    // Set C (held in floats, as it always has been here):
+    float cx = 0.7454054;
+    float cy = 0.1130063;
+
+    // reuse cached tiles if the cache is on, else compute every pixel (i, j)
+    if (julia_renderCached(im, x0, y1, pixelwidth, cx, cy)) {
+        julia_render(im, x0, y1, pixelwidth, pixelwidth, cx, cy, 0, 2, 0, NULL,
+                     NULL, NULL);
+    }
+}
+
+/**
+ * Progressive version of image_julia(). The image is first computed at every
+ * FRACTAL_COARSE_STEP-th pixel and then refined in passes, and progress
+ * (which may be NULL) is called with the image after each pass. If cancel is
+ * cancelled from another thread, the render stops early and the image is
+ * returned with whatever passes were finished; check fractal_cancelled() to
+ * tell. The final image is identical to image_julia()'s.
+ */
+Image *image_juliaProgressive(float x0, float y0, float x1, float y1, int rows,
+                              FractalProgress progress, void *arg,
+                              FractalCancel *cancel) {
+    Image *im;
+    int cols;
+
+    cols = ((x1 - x0) * rows) / (y1 - y0);
+    im = image_create(rows, cols);
+    if (im) {
+        julia_render(im, x0, y1, (x1 - x0) / cols, (y1 - y0) / rows, CX, CY, 1,
+                     1, 1, progress, arg, cancel);
+    }
+    return(im);
+}
+
+/**
+ * Progressive version of julia(), with progress, arg, and cancel as for
+ * image_juliaProgressive(). Returns 0 once the image is complete,
+ * FRACTAL_CANCELLED if the render was cancelled, or -1 on failure.
+ */
+int julia_progressive(Image *im, float x0, float y0, float dx,
+                      FractalProgress progress, void *arg,
+                      FractalCancel *cancel) {
+    if (!im) {
+        printf("julia_progressive(): passed NULL pointer.\n");
+        return -1;
+    }
+
+    image_reset(im);
+    float pixelwidth = dx / im->cols;
+    float y1 = y0 + pixelwidth * im->rows;
+    float cx = 0.7454054;
+    float cy = 0.1130063;
+
+    return julia_render(im, x0, y1, pixelwidth, pixelwidth, cx, cy, 0, 2, 1,
+                        progress, arg, cancel);
+}
+
+/**
+ * Store the counts of row i of the view in the job's IterBuffer, with the
+ * fractions of a smooth buffer.
+ */
+static void julia_countRow(int i, int worker, void *arg) {
+    JuliaJob *job = arg;
+    IterBuffer *b = job->buffer;
+    int *counts = job->iters + (size_t) i * b->cols;
+    float last[2];
+
+    if (b->smooth) {
+        float *frac = job->frac + (size_t) i * b->cols;
+        for (int j = 0; j < b->cols; j++) {
+            counts[j] = julia_pixel(job, i, j, last);
+            frac[j] = iterbuffer_smooth(last[0], last[1]);
+        }
+        iterbuffer_setRow(b, i, counts, frac);
+    } else {
+        for (int j = 0; j < b->cols; j++) {
+            counts[j] = julia_pixel(job, i, j, NULL);
+        }
+        iterbuffer_setRow(b, i, counts, NULL);
+    }
+}
+
+/**
+ * Compute the iteration counts of the view julia() would draw into an image
+ * the size of b, storing them in b (with fractions if b is smooth) rather
+ * than coloring an image. Color them with palette_apply(), as often as
+ * desired. Rows are computed in parallel. Returns 0, or -1 on failure.
+ */
+int julia_iterations(IterBuffer *b, float x0, float y0, float dx) {
+    JuliaJob job;
+    float pixelwidth, cx = 0.7454054, cy = 0.1130063;
+    size_t n;
+    int result = -1;
+
+    if (!b) {
+        printf("julia_iterations(): passed NULL pointer.\n");
+        return -1;
+    }
+    if (b->maxIter < ITERATIONS) {
+        printf("julia_iterations(): buffer holds fewer than %d iterations.\n",
+               ITERATIONS);
+        return -1;
+    }
+
+    pixelwidth = dx / b->cols;
+    if (julia_jobInit(&job, NULL, x0, y0 + pixelwidth * b->rows, pixelwidth,
+                      pixelwidth, cx, cy, 0, 2)) {
+        return -1;
+    }
+
+    n = (size_t) b->rows * b->cols;
+    job.buffer = b;
+    job.iters = malloc(sizeof(int) * n);
+    job.frac = b->smooth ? malloc(sizeof(float) * n) : NULL;
+    if (job.iters && (!b->smooth || job.frac)) {
+        parallel_for(b->rows, julia_countRow, &job);
+        result = 0;
+    } else {
+        printf("julia_iterations(): malloc() failed.\n");
+    }
+    free(job.iters);
+    free(job.frac);
+
+    return result;
+}
+
+/* Animations render JULIA_FRAMES_IN_FLIGHT frames at a time as one pool of
+(frame, tile) work items, so threads stay busy both when a frame has fewer
+tiles than there are threads and when some frames cost far more than others.
+Finished frames are handed to the sink in order and their images reused. */
+typedef struct {
+    JuliaJob frame[JULIA_FRAMES_IN_FLIGHT];
+    double bound[JULIA_FRAMES_IN_FLIGHT]; // |z|^2 beyond which the count is 0
+    int tilesAcross, tilesPerFrame;
+} JuliaAnimation;
+
+/**
+ * Return the squared radius beyond which a start value escapes on the first
+ * iteration for the constant c: |z^2 - c| >= |z|^2 - |c| > 2 once
+ * |z|^2 > 2 + |c|. A small margin covers float rounding.
+ */
+static double julia_escapeBound(double cx, double cy) {
+    return (2.0 + hypot(cx, cy)) * 1.001;
+}
+
+/**
+ * Render one FRACTAL_TILE square tile of one frame. Tiles lying wholly
+ * outside the escape bound are colored with count 0 without iterating, and
+ * so are pixels outside it in the other tiles.
+ */
+static void julia_animateTile(int index, int worker, void *arg) {
+    JuliaAnimation *anim = arg;
+    int f = index / anim->tilesPerFrame;
+    int t = index % anim->tilesPerFrame;
+    JuliaJob *job = &anim->frame[f];
+    double bound = anim->bound[f];
+    int r0 = (t / anim->tilesAcross) * FRACTAL_TILE;
+    int c0 = (t % anim->tilesAcross) * FRACTAL_TILE;
+    int r1 = r0 + FRACTAL_TILE < job->im->rows ? r0 + FRACTAL_TILE : job->im->rows;
+    int c1 = c0 + FRACTAL_TILE < job->im->cols ? c0 + FRACTAL_TILE : job->im->cols;
+
+    // Nearest point of the tile to the origin
+    double left = job->sx * c0 + job->x0, right = job->sx * (c1 - 1) + job->x0;
+    double top = -job->sy * r0 + job->y1, bottom = -job->sy * (r1 - 1) + job->y1;
+    double nx = left > 0 ? left : (right < 0 ? right : 0);
+    double ny = bottom > 0 ? bottom : (top < 0 ? top : 0);
+    int outside = nx * nx + ny * ny > bound;
+
+    for (int i = r0; i < r1; i++) {
+        for (int j = c0; j < c1; j++) {
+            int numIters = 0;
+
+            if (!outside) {
+                double x = job->sx * j + job->x0, y = -job->sy * i + job->y1;
+                if (x * x + y * y <= bound) {
+                    numIters = julia_pixel(job, i, j, NULL);
                 }
+            }
+            julia_color(job, i, j, numIters);
+        }
+    }
+}
+
+/**
+ * Render nFrames Julia sets, frame k for the constant (cx[k], cy[k]), each
+ * rows x cols over the same view julia() would draw for (x0, y0, dx), and pass
+ * them in order to sink along with arg. A frame whose c is a float value is
+ * identical to julia()'s image. Frames are rendered JULIA_FRAMES_IN_FLIGHT
+ * at a time, with the tiles of all of them shared between threads. Returns
+ * the number of frames rendered, or -1 on failure.
+ */
+int julia_animate(int nFrames, const double *cx, const double *cy, int rows,
+                  int cols, float x0, float y0, float dx, JuliaFrameSink sink,
+                  void *arg) {
+    JuliaAnimation anim;
+    Image *frames[JULIA_FRAMES_IN_FLIGHT] = {NULL};
+    float pixelwidth, y1;
+    int inFlight, done = 0;
 
-                numIters = n;
+    if (!cx || !cy || !sink) {
+        printf("julia_animate(): passed NULL pointer.\n");
+        return -1;
+    }
+    if (nFrames <= 0 || rows <= 0 || cols <= 0) {
+        return 0;
+    }
+
+    pixelwidth = dx / cols;
+    y1 = y0 + pixelwidth * rows;
+    inFlight = nFrames < JULIA_FRAMES_IN_FLIGHT ? nFrames : JULIA_FRAMES_IN_FLIGHT;
+    anim.tilesAcross = (cols + FRACTAL_TILE - 1) / FRACTAL_TILE;
+    anim.tilesPerFrame = anim.tilesAcross * ((rows + FRACTAL_TILE - 1) / FRACTAL_TILE);
+
+    for (int f = 0; f < inFlight; f++) {
+        frames[f] = image_create(rows, cols);
+        if (!frames[f]) {
+            done = -1;
+            break;
+        }
+    }
+
+    while (done >= 0 && done < nFrames) {
+        int batch = nFrames - done < inFlight ? nFrames - done : inFlight;
+
+        for (int f = 0; f < batch; f++) {
+            image_reset(frames[f]);
+            if (julia_jobInit(&anim.frame[f], frames[f], x0, y1, pixelwidth,
+                              pixelwidth, cx[done + f], cy[done + f], 1, 2)) {
+                done = -1;
+                break;
             }
-            // color pixel (i, j)
-            image_setc(im, i, j, 0, log((double) numIters));
-            image_setc(im, i, j, 2, 1.0 / log(((double) numIters)));
+            anim.bound[f] = julia_escapeBound(cx[done + f], cy[done + f]);
+        }
+        if (done < 0) {
+            break;
+        }
+
+        parallel_for(batch * anim.tilesPerFrame, julia_animateTile, &anim);
+        for (int f = 0; f < batch; f++) {
+            sink(frames[f], done + f, arg);
         }
+        done += batch;
     }
-    return;
+
+    for (int f = 0; f < inFlight; f++) {
+        if (frames[f]) {
+            image_free(frames[f]);
+        }
+    }
+
+    return done;
+}
+
+/**
+ * A JuliaFrameSink that writes each frame to a PPM file named by the printf
+ * pattern, which takes the frame index (e.g. "julia-%04d.ppm").
+ */
+void julia_frameWriter(Image *frame, int index, void *pattern) {
+    char filename[256];
+
+    if (!frame || !pattern) {
+        printf("julia_frameWriter(): passed NULL pointer.\n");
+        return;
+    }
+
+    snprintf(filename, sizeof(filename), (const char *) pattern, index);
+    image_write(frame, filename);
 }
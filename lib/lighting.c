@@ -0,0 +1,717 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Implements lighting.h: a set of ambient, directional, and point lights and
+ * the shading calculations that use them.
+ *
+ * Shading follows the usual body (diffuse) plus surface (specular) model:
+ *
+ *     C = Cb * Ia + sum over lights of  Il * (Cb * (N.L) + Cs * (N.H)^s)
+ *
+ * where N is the surface normal, L the unit vector towards the light, H the
+ * halfway vector between L and the unit vector V towards the viewer, and s
+ * the surface's sharpness. A light with a shadow map only adds its term
+ * where the map shows nothing between it and the point. Vertices are shaded
+ * in batches: each light is
+ * applied to the whole batch in a few loops over the batch's arrays before
+ * moving to the next light, so the loops stay short and branch free and the
+ * compiler can vectorize them.
+ */
+#include "graphicslib.h"
+
+/* LIGHTING FUNCTIONS */
+
+/**
+ * Allocate and return a Lighting with no lights.
+ */
+Lighting *lighting_create(void) {
+    Lighting *toReturn = malloc(sizeof(Lighting));
+    if (!toReturn) {
+        printf("lighting_create(): malloc failed.\n");
+        return NULL;
+    }
+
+    lighting_init(toReturn);
+    return toReturn;
+}
+
+/**
+ * Initialize the Lighting to have no lights.
+ */
+void lighting_init(Lighting *l) {
+    if (!l) {
+        printf("lighting_init(): passed NULL pointer.\n");
+        return;
+    }
+
+    color_set(&(l->ambient), 0.0, 0.0, 0.0);
+    l->nDirect = 0;
+    l->nPoint = 0;
+}
+
+/**
+ * Free the Lighting.
+ */
+void lighting_free(Lighting *l) {
+    free(l);
+}
+
+/**
+ * Remove every light from the Lighting.
+ */
+void lighting_clear(Lighting *l) {
+    lighting_init(l);
+}
+
+/**
+ * Add a copy of the light to the Lighting. Ambient lights are summed; at most
+ * MAX_LIGHTS directional and MAX_LIGHTS point lights can be added.
+ */
+void lighting_add(Lighting *l, Light *light) {
+    if (!l || !light) {
+        printf("lighting_add(): passed NULL pointer.\n");
+        return;
+    }
+
+    switch (light->type) {
+    case LightAmbient:
+        for (int k = 0; k < 3; k++) {
+            l->ambient.c[k] += light->color.c[k];
+        }
+        break;
+
+    case LightDirect: ;
+        Vector toLight;
+        int d = l->nDirect;
+        if (d == MAX_LIGHTS) {
+            printf("lighting_add(): too many directional lights.\n");
+            return;
+        }
+        vector_set(&toLight, -light->direction.val[0],
+                   -light->direction.val[1], -light->direction.val[2]);
+        if (vector_length(&toLight) == 0.0) {
+            printf("lighting_add(): directional light has no direction.\n");
+            return;
+        }
+        vector_normalize(&toLight);
+        l->directX[d] = toLight.val[0];
+        l->directY[d] = toLight.val[1];
+        l->directZ[d] = toLight.val[2];
+        l->directR[d] = light->color.c[0];
+        l->directG[d] = light->color.c[1];
+        l->directB[d] = light->color.c[2];
+        l->directShadow[d] = light->shadow;
+        l->nDirect++;
+        break;
+
+    case LightPoint: ;
+        int p = l->nPoint;
+        double h = light->position.val[3] != 0.0 ? light->position.val[3] : 1.0;
+        if (p == MAX_LIGHTS) {
+            printf("lighting_add(): too many point lights.\n");
+            return;
+        }
+        l->pointX[p] = light->position.val[0] / h;
+        l->pointY[p] = light->position.val[1] / h;
+        l->pointZ[p] = light->position.val[2] / h;
+        l->pointR[p] = light->color.c[0];
+        l->pointG[p] = light->color.c[1];
+        l->pointB[p] = light->color.c[2];
+        l->pointShadow[p] = light->shadow;
+        l->nPoint++;
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+    Scale the first n vectors (x, y, z) to unit length, leaving zero vectors
+    as they are.
+ */
+static void normalizeBatch(int n, float *restrict x, float *restrict y,
+                           float *restrict z) {
+    float scale[SHADE_BATCH];
+
+    for (int i = 0; i < n; i++) {
+        scale[i] = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+    }
+    for (int i = 0; i < n; i++) {
+        scale[i] = scale[i] > 0.0f ? 1.0f / sqrtf(scale[i]) : 0.0f;
+    }
+    for (int i = 0; i < n; i++) {
+        x[i] *= scale[i];
+        y[i] *= scale[i];
+        z[i] *= scale[i];
+    }
+}
+
+/*
+    Set visible[i] to lit[i] for the first n points of the batch that the
+    shadow map shows are in view of its light, and to 0 for those hidden
+    behind something nearer the light. Points outside the map are in view.
+ */
+static void shadowTest(ShadowMap *sm, ShadeBatch *batch, int n,
+                       const float *lit, float *visible) {
+    float mx[SHADE_BATCH], my[SHADE_BATCH], mz[SHADE_BATCH];
+    float m[4][4];
+    Image *map = sm->depth;
+    float limit = 1.0f + sm->bias;
+
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            m[r][c] = sm->vtm.m[r][c];
+        }
+    }
+
+    // Project the points into the map
+    for (int i = 0; i < n; i++) {
+        float x = batch->x[i], y = batch->y[i], z = batch->z[i];
+        float h = m[3][0] * x + m[3][1] * y + m[3][2] * z + m[3][3];
+
+        h = h > 0.0f ? h : -1.0f; // behind the light: off the map
+        mx[i] = (m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3]) / h;
+        my[i] = (m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3]) / h;
+        mz[i] = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+    }
+
+    /* The map holds 1/z of the nearest surface, so a point at depth z is
+    behind it when z * depth > 1 */
+    for (int i = 0; i < n; i++) {
+        visible[i] = lit[i];
+        if (mx[i] >= 0.0f && mx[i] < map->cols &&
+            my[i] >= 0.0f && my[i] < map->rows) {
+            float depth = map->depth[(int) my[i] * map->cols + (int) mx[i]];
+            if (mz[i] * depth > limit) {
+                visible[i] = 0.0f;
+            }
+        }
+    }
+}
+
+/*
+    Add the body and surface reflection of one light to the colors of the
+    first n vertices of the batch. (lx, ly, lz) are the unit vectors from each
+    vertex towards the light and (vx, vy, vz) towards the viewer. lit is 0 for
+    vertices whose back faces the viewer and 1 otherwise.
+ */
+static void shadeLight(ShadeBatch *batch, int n, const float *lx,
+                       const float *ly, const float *lz, const float *vx,
+                       const float *vy, const float *vz, const float *lit,
+                       float lr, float lg, float lb, Color *body,
+                       Color *surface, float exponent) {
+    float diffuse[SHADE_BATCH]; // N.L, or 0 if the light is behind
+    float spec[SHADE_BATCH]; // (N.H)^2, then (N.H)^s
+
+    for (int i = 0; i < n; i++) {
+        float nl = batch->nx[i] * lx[i] + batch->ny[i] * ly[i] +
+                   batch->nz[i] * lz[i];
+        float hx = lx[i] + vx[i];
+        float hy = ly[i] + vy[i];
+        float hz = lz[i] + vz[i];
+        float nh = batch->nx[i] * hx + batch->ny[i] * hy + batch->nz[i] * hz;
+        float hh = hx * hx + hy * hy + hz * hz;
+        float cos2 = nh * nh / (hh > 0.0f ? hh : 1.0f);
+        float facing = (nl > 0.0f ? 1.0f : 0.0f) * lit[i]; // lit by the light
+
+        diffuse[i] = facing * nl;
+        spec[i] = (nh > 0.0f ? cos2 : 0.0f) * facing;
+    }
+
+    /* The halfway vector isn't normalized; the exponent is halved instead,
+    since (N.H)^s = ((N.H)^2)^(s/2) */
+    for (int i = 0; i < n; i++) {
+        if (spec[i] > 0.0f) {
+            spec[i] = powf(spec[i], exponent);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        batch->r[i] += lr * (body->c[0] * diffuse[i] + surface->c[0] * spec[i]);
+        batch->g[i] += lg * (body->c[1] * diffuse[i] + surface->c[1] * spec[i]);
+        batch->b[i] += lb * (body->c[2] * diffuse[i] + surface->c[2] * spec[i]);
+    }
+}
+
+/**
+ * Shade every vertex of the batch with all of the lights, seen from the
+ * viewer, for a surface with the given body and surface colors and
+ * sharpness. The normals must have unit length. Normals pointing away from
+ * the viewer are flipped, unless oneSided is set, in which case the vertex
+ * only receives ambient light. Colors are clamped to 1.
+ */
+void lighting_shadeBatch(Lighting *l, ShadeBatch *batch, Point *viewer,
+                         Color *body, Color *surface, float sharpness,
+                         int oneSided) {
+    float vx[SHADE_BATCH], vy[SHADE_BATCH], vz[SHADE_BATCH];
+    float lx[SHADE_BATCH], ly[SHADE_BATCH], lz[SHADE_BATCH];
+    float lit[SHADE_BATCH];
+    float shadowed[SHADE_BATCH]; // lit, and not in the light's shadow
+    float exponent = sharpness * 0.5f;
+    float hideBack = oneSided ? 1.0f : 0.0f;
+    float ex, ey, ez;
+    int n;
+
+    if (!l || !batch || !viewer || !body || !surface) {
+        printf("lighting_shadeBatch(): passed NULL pointer.\n");
+        return;
+    }
+    ex = viewer->val[0];
+    ey = viewer->val[1];
+    ez = viewer->val[2];
+    n = batch->n < SHADE_BATCH ? batch->n : SHADE_BATCH;
+
+    /* Pad the batch to a multiple of 4 vertices so every loop below runs a
+    whole number of 4-wide vector steps. The padding is shaded and ignored */
+    for (int i = n; i < ((n + 3) & ~3); i++) {
+        batch->x[i] = batch->y[i] = batch->z[i] = 0.0f;
+        batch->nx[i] = batch->ny[i] = batch->nz[i] = 0.0f;
+    }
+    n = (n + 3) & ~3;
+
+    // View vectors
+    for (int i = 0; i < n; i++) {
+        vx[i] = ex - batch->x[i];
+        vy[i] = ey - batch->y[i];
+        vz[i] = ez - batch->z[i];
+    }
+    normalizeBatch(n, vx, vy, vz);
+
+    // Ambient light, and normals turned towards the viewer
+    for (int i = 0; i < n; i++) {
+        float nv = batch->nx[i] * vx[i] + batch->ny[i] * vy[i] +
+                   batch->nz[i] * vz[i];
+        float back = nv < 0.0f ? 1.0f : 0.0f;
+
+        batch->nx[i] *= 1.0f - 2.0f * back;
+        batch->ny[i] *= 1.0f - 2.0f * back;
+        batch->nz[i] *= 1.0f - 2.0f * back;
+        lit[i] = 1.0f - back * hideBack;
+
+        batch->r[i] = body->c[0] * l->ambient.c[0];
+        batch->g[i] = body->c[1] * l->ambient.c[1];
+        batch->b[i] = body->c[2] * l->ambient.c[2];
+    }
+
+    for (int j = 0; j < l->nDirect; j++) {
+        for (int i = 0; i < n; i++) {
+            lx[i] = l->directX[j];
+            ly[i] = l->directY[j];
+            lz[i] = l->directZ[j];
+        }
+        if (l->directShadow[j]) {
+            shadowTest(l->directShadow[j], batch, n, lit, shadowed);
+        }
+        shadeLight(batch, n, lx, ly, lz, vx, vy, vz,
+                   l->directShadow[j] ? shadowed : lit, l->directR[j],
+                   l->directG[j], l->directB[j], body, surface, exponent);
+    }
+
+    for (int j = 0; j < l->nPoint; j++) {
+        for (int i = 0; i < n; i++) {
+            lx[i] = l->pointX[j] - batch->x[i];
+            ly[i] = l->pointY[j] - batch->y[i];
+            lz[i] = l->pointZ[j] - batch->z[i];
+        }
+        normalizeBatch(n, lx, ly, lz);
+        if (l->pointShadow[j]) {
+            shadowTest(l->pointShadow[j], batch, n, lit, shadowed);
+        }
+        shadeLight(batch, n, lx, ly, lz, vx, vy, vz,
+                   l->pointShadow[j] ? shadowed : lit, l->pointR[j],
+                   l->pointG[j], l->pointB[j], body, surface, exponent);
+    }
+
+    for (int i = 0; i < n; i++) {
+        batch->r[i] = batch->r[i] < 1.0f ? batch->r[i] : 1.0f;
+        batch->g[i] = batch->g[i] < 1.0f ? batch->g[i] : 1.0f;
+        batch->b[i] = batch->b[i] < 1.0f ? batch->b[i] : 1.0f;
+    }
+}
+
+/**
+ * Shade a single point p with unit normal N, as lighting_shadeBatch() does
+ * for a batch, and put the result in c.
+ */
+void lighting_shading(Lighting *l, Vector *N, Point *p, Point *viewer,
+                      Color *body, Color *surface, float sharpness,
+                      int oneSided, Color *c) {
+    ShadeBatch batch;
+
+    if (!l || !N || !p || !viewer || !body || !surface || !c) {
+        printf("lighting_shading(): passed NULL pointer.\n");
+        return;
+    }
+
+    batch.n = 1;
+    batch.x[0] = p->val[0];
+    batch.y[0] = p->val[1];
+    batch.z[0] = p->val[2];
+    batch.nx[0] = N->val[0];
+    batch.ny[0] = N->val[1];
+    batch.nz[0] = N->val[2];
+    lighting_shadeBatch(l, &batch, viewer, body, surface, sharpness, oneSided);
+    color_set(c, batch.r[0], batch.g[0], batch.b[0]);
+}
+
+/**
+ * Shade the n world space vertices with their normals, putting the results in
+ * color, using the viewer and the body color, surface color, and sharpness of
+ * the DrawState. The normals need not have unit length. If normal is NULL,
+ * the vertices are taken to be a polygon and all of them use its face normal.
+ */
+void lighting_shadeVertices(Lighting *l, int n, Point *vertex, Vector *normal,
+                            DrawState *ds, int oneSided, Color *color) {
+    ShadeBatch batch;
+    Vector face;
+
+    if (!l || !vertex || !ds || !color) {
+        printf("lighting_shadeVertices(): passed NULL pointer.\n");
+        return;
+    }
+
+    if (!normal) {
+        Polygon p;
+        polygon_init(&p);
+        p.nVertex = n;
+        p.vertex = vertex;
+        polygon_faceNormal(&p, &face);
+    }
+
+    for (int start = 0; start < n; start += SHADE_BATCH) {
+        batch.n = n - start < SHADE_BATCH ? n - start : SHADE_BATCH;
+        for (int i = 0; i < batch.n; i++) {
+            Point *p = &vertex[start + i];
+            Vector *N = normal ? &normal[start + i] : &face;
+            double len = vector_length(N);
+            double inv = len > 0.0 ? 1.0 / len : 0.0;
+
+            batch.x[i] = p->val[0];
+            batch.y[i] = p->val[1];
+            batch.z[i] = p->val[2];
+            batch.nx[i] = N->val[0] * inv;
+            batch.ny[i] = N->val[1] * inv;
+            batch.nz[i] = N->val[2] * inv;
+        }
+
+        lighting_shadeBatch(l, &batch, &(ds->viewer), &(ds->body),
+                            &(ds->surface), ds->surfaceCoeff, oneSided);
+
+        for (int i = 0; i < batch.n; i++) {
+            color_set(&color[start + i], batch.r[i], batch.g[i], batch.b[i]);
+        }
+    }
+}
+
+/**
+ * The setup stage of flat and Gouraud shading for a polygon in world
+ * coordinates, run before it is taken to the screen. For ShadeFlat the
+ * polygon is shaded just once, at its centroid and with its face normal, and
+ * the color is left in ds->flatColor for polygon_drawFill(), which fills
+ * with a constant color. For ShadeGouraud every vertex is shaded into the
+ * polygon's colors. Other shade methods need no setup.
+ */
+void lighting_shadePolygon(Lighting *l, Polygon *p, DrawState *ds) {
+    Point centroid;
+    Vector N;
+
+    if (!l || !p || !ds) {
+        printf("lighting_shadePolygon(): passed NULL pointer.\n");
+        return;
+    }
+    if (p->nVertex <= 0) {
+        return;
+    }
+
+    switch (ds->shade) {
+    case ShadeFlat:
+        point_set3D(&centroid, 0.0, 0.0, 0.0);
+        for (int i = 0; i < p->nVertex; i++) {
+            for (int k = 0; k < 3; k++) {
+                centroid.val[k] += p->vertex[i].val[k] / p->nVertex;
+            }
+        }
+        polygon_faceNormal(p, &N);
+        if (vector_length(&N) > 0.0) {
+            vector_normalize(&N);
+        }
+        lighting_shading(l, &N, &centroid, &(ds->viewer), &(ds->body),
+                         &(ds->surface), ds->surfaceCoeff, p->oneSided,
+                         &(ds->flatColor));
+        break;
+
+    case ShadeGouraud:
+        if (p->color) {
+            lighting_shadeVertices(l, p->nVertex, p->vertex, p->normal, ds,
+                                   p->oneSided, p->color);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* Everything the rows of a deferred lighting pass share */
+typedef struct {
+    Lighting *l;
+    Image *src;
+    Point *viewer;
+    /* The pixel centred at screen (x, y) with depth 1/z shows the world point
+    z * (ray + x * dx + y * dy) + origin */
+    float ray[3], dx[3], dy[3], origin[3];
+} GBufferJob;
+
+/*
+    Shade the batch of G-buffer pixels from one row, all of the same
+    material, whose columns are in column; on entry the batch holds their
+    depths in z and their normals, and the colors go straight to the image.
+ */
+static void gbuffer_shadeRun(GBufferJob *job, int row, ShadeBatch *batch,
+                             int *column, Material *m) {
+    Image *src = job->src;
+    int n = batch->n;
+    float y = row + 0.5f;
+    float rx = job->ray[0] + y * job->dy[0];
+    float ry = job->ray[1] + y * job->dy[1];
+    float rz = job->ray[2] + y * job->dy[2];
+    float dx = job->dx[0], dy = job->dx[1], dz = job->dx[2];
+    float ox = job->origin[0], oy = job->origin[1], oz = job->origin[2];
+    int padded = (n + 3) & ~3;
+
+    /* Pad the run to a multiple of 4 pixels, as lighting_shadeBatch() does,
+    so the loops below vectorize */
+    for (int i = n; i < padded; i++) {
+        column[i] = 0;
+        batch->z[i] = 1.0f;
+        batch->nx[i] = batch->ny[i] = batch->nz[i] = 0.0f;
+    }
+
+    for (int i = 0; i < padded; i++) {
+        float z = 1.0f / batch->z[i];
+        float x = column[i] + 0.5f;
+
+        batch->x[i] = z * (rx + x * dx) + ox;
+        batch->y[i] = z * (ry + x * dy) + oy;
+        batch->z[i] = z * (rz + x * dz) + oz;
+    }
+    normalizeBatch(padded, batch->nx, batch->ny, batch->nz);
+
+    lighting_shadeBatch(job->l, batch, job->viewer, &m->body, &m->surface,
+                        m->sharpness, m->oneSided);
+
+    for (int i = 0; i < n; i++) {
+        FPixel *px = &src->data[row * src->cols + column[i]];
+        px->rgb[0] = batch->r[i];
+        px->rgb[1] = batch->g[i];
+        px->rgb[2] = batch->b[i];
+    }
+}
+
+/*
+    parallel_for() task lighting one row of the G-buffer. Covered pixels are
+    gathered into batches of neighbours that share a material.
+ */
+static void gbuffer_shadeRow(int row, int worker, void *arg) {
+    GBufferJob *job = arg;
+    Image *src = job->src;
+    ShadeBatch batch;
+    int column[SHADE_BATCH];
+    int current = -1;
+
+    batch.n = 0;
+    for (int c = 0; c < src->cols; c++) {
+        int index = row * src->cols + c;
+        int m = src->material[index];
+        float *n = &src->normal[index * 3];
+
+        if (m < 0) {
+            continue;
+        }
+        if (batch.n == SHADE_BATCH || (batch.n > 0 && m != current)) {
+            gbuffer_shadeRun(job, row, &batch, column,
+                             &src->materials[current]);
+            batch.n = 0;
+        }
+
+        current = m;
+        column[batch.n] = c;
+        batch.z[batch.n] = src->depth[index];
+        batch.nx[batch.n] = n[0];
+        batch.ny[batch.n] = n[1];
+        batch.nz[batch.n] = n[2];
+        batch.n++;
+    }
+
+    if (batch.n > 0) {
+        gbuffer_shadeRun(job, row, &batch, column, &src->materials[current]);
+    }
+}
+
+/**
+ * Deferred shading: color every pixel of the image's G-buffer that a
+ * surface was drawn into, using the lights, the viewer, and the pixel's
+ * material and interpolated normal. Each pixel is shaded once however many
+ * surfaces were drawn over it. World positions are recovered from the depth
+ * with the VTM from matrix_setView3D() the G-buffer was drawn with, whose
+ * homogeneous coordinate is a multiple of its z; other VTMs, such as the
+ * parallel projection's, are rejected. Rows are shaded in parallel.
+ */
+void lighting_shadeGBuffer(Lighting *l, Image *src, Matrix *VTM,
+                           Point *viewer) {
+    GBufferJob job;
+    Matrix it;
+    double k;
+    double (*m)[4];
+    int j = 0;
+
+    if (!l || !src || !VTM || !viewer) {
+        printf("lighting_shadeGBuffer(): passed NULL pointer.\n");
+        return;
+    }
+    if (!src->material) {
+        return;
+    }
+    m = VTM->m;
+
+    // The screen z and homogeneous rows are proportional: h = k * z
+    for (int c = 1; c < 3; c++) {
+        if (fabs(m[2][c]) > fabs(m[2][j])) {
+            j = c;
+        }
+    }
+    if (m[2][j] == 0.0) {
+        printf("lighting_shadeGBuffer(): VTM has no depth.\n");
+        return;
+    }
+    k = m[3][j] / m[2][j];
+    if (k == 0.0) {
+        printf("lighting_shadeGBuffer(): VTM is not a perspective view.\n");
+        return;
+    }
+
+    // The transpose of the inverse transpose inverts the VTM's linear part
+    if (matrix_inverseTranspose(VTM, &it)) {
+        printf("lighting_shadeGBuffer(): VTM is singular.\n");
+        return;
+    }
+
+    /* A pixel at (x, y) with depth 1/z satisfies the VTM's first three rows
+    for the world point P = inverse * (k*x*z - m03, k*y*z - m13, z - m23) */
+    for (int r = 0; r < 3; r++) {
+        job.dx[r] = k * it.m[0][r];
+        job.dy[r] = k * it.m[1][r];
+        job.ray[r] = it.m[2][r];
+        job.origin[r] = -(it.m[0][r] * m[0][3] + it.m[1][r] * m[1][3] +
+                          it.m[2][r] * m[2][3]);
+    }
+
+    job.l = l;
+    job.src = src;
+    job.viewer = viewer;
+    parallel_for(src->rows, gbuffer_shadeRow, &job);
+}
+
+/* LIGHT FUNCTIONS */
+
+/**
+ * Set the fields of the light. direction is only used by directional lights
+ * and position only by point lights; either may be NULL when unused.
+ */
+void light_set(Light *light, LightType type, Color *c, Vector *direction,
+               Point *position) {
+    if (!light || !c) {
+        printf("light_set(): passed NULL pointer.\n");
+        return;
+    }
+
+    light->type = type;
+    color_copy(&(light->color), c);
+    if (direction) {
+        vector_copy(&(light->direction), direction);
+    } else {
+        vector_set(&(light->direction), 0.0, 0.0, -1.0);
+    }
+    if (position) {
+        point_copy(&(light->position), position);
+    } else {
+        point_set3D(&(light->position), 0.0, 0.0, 0.0);
+    }
+    light->shadow = NULL;
+}
+
+/**
+ * Give the light a shadow map, which must outlive every Lighting and Module
+ * the light is added to, or take it away with NULL.
+ */
+void light_setShadow(Light *light, ShadowMap *shadow) {
+    if (!light) {
+        printf("light_setShadow(): passed NULL pointer.\n");
+        return;
+    }
+
+    light->shadow = shadow;
+}
+
+/* SHADOW MAP FUNCTIONS */
+
+/**
+ * Allocate a shadow map seen through the view pipeline, with a depth image
+ * of the view's screen size. The map is empty until drawn with
+ * module_drawShadowMap(). Returns NULL on failure.
+ */
+ShadowMap *shadowmap_create(ViewPipeline *view) {
+    ShadowMap *sm;
+
+    if (!view) {
+        printf("shadowmap_create(): passed NULL pointer.\n");
+        return NULL;
+    }
+
+    sm = malloc(sizeof(ShadowMap));
+    if (!sm) {
+        printf("shadowmap_create(): malloc failed.\n");
+        return NULL;
+    }
+    sm->depth = image_create(view->view.screeny, view->view.screenx);
+    if (!sm->depth) {
+        free(sm);
+        return NULL;
+    }
+
+    matrix_copy(&sm->vtm, &view->vtm);
+    sm->clipNear = view->clipNear;
+    sm->clipFar = view->clipFar;
+    sm->bias = 0.02;
+    imagefillz(sm->depth, 0.0);
+    return sm;
+}
+
+/**
+ * Free the shadow map and its depth image.
+ */
+void shadowmap_free(ShadowMap *sm) {
+    if (!sm) {
+        return;
+    }
+
+    image_free(sm->depth);
+    free(sm);
+}
+
+/**
+ * Transform the light's position and direction by the matrix m.
+ */
+void light_xform(Matrix *m, Light *light) {
+    Vector direction;
+
+    if (!m || !light) {
+        printf("light_xform(): passed NULL pointer.\n");
+        return;
+    }
+
+    matrix_xformPoint(m, &(light->position), &(light->position));
+    matrix_xformVector(m, &(light->direction), &direction);
+    vector_copy(&(light->direction), &direction);
+}
@@ -17,10 +17,513 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <limits.h>
 #include "graphicslib.h"
 
 #define ITERATIONS 1000
 
+/* The escape-time loop is the whole cost of a render, so on x86 it is also
+compiled for AVX2 (8 pixels) and AVX-512 (16 pixels) and the widest version the
+CPU supports is picked at runtime. Lanes iterate in lockstep and drop out as
+they escape. The vector code performs exactly the same float operations, in the
+same order, as the scalar loop (FMA contraction is disabled, since fusing would
+change the rounding), so every path returns identical iteration counts. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MANDELBROT_SIMD
+#include <immintrin.h>
+#endif
+
+static int mandelbrot_flags = 0; // MANDELBROT_* shortcuts in use
+
+/**
+ * Turn the interior shortcuts on or off. flags is a combination of
+ * MANDELBROT_INTERIOR, which answers points in the main cardioid and the
+ * period-2 bulb in closed form, and MANDELBROT_PERIODICITY, which stops
+ * iterating once an orbit returns exactly to an earlier value (Brent's
+ * method, comparing against z saved at power-of-two steps). A repeated orbit
+ * can never escape, so periodicity checking returns exactly the brute-force
+ * count; the closed-form tests can disagree with float iteration for points
+ * within rounding error of the boundary. The default, 0, is pure brute force.
+ * Should not be called while a render is running.
+ */
+void mandelbrot_setShortcuts(int flags) {
+    mandelbrot_flags = flags;
+}
+
+/**
+ * Returns 1 if c lies in the main cardioid or the period-2 bulb. The set is
+ * iterated here as z^2 - c, so it is the usual one mirrored through the
+ * origin and the usual tests are applied to -c.
+ */
+static int mandelbrot_interior(float cx, float cy) {
+    double a = -cx, b = -cy;
+    double q = (a - 0.25) * (a - 0.25) + b * b;
+
+    if (q * (q + (a - 0.25)) <= 0.25 * b * b) {
+        return 1;
+    }
+    return (a + 1.0) * (a + 1.0) + b * b <= 0.0625;
+}
+
+/**
+ * The scalar escape-time loop. If periodic is set, z is compared against a
+ * reference value that is refreshed whenever n + 1 is a power of two. If last
+ * is not NULL it receives the final z.
+ */
+static int mandelbrot_iterate(float cx, float cy, int maxIter, int periodic,
+                              float *last) {
+    float zx = 0, zy = 0, zx_temp, zy_temp;
+    float rx = 0, ry = 0;
+    int n;
+
+    for (n = 0; n < maxIter; n++) {
+        zx_temp = zx * zx - zy * zy - cx;
+        zy_temp = 2 * zx * zy - cy;
+        zx = zx_temp;
+        zy = zy_temp;
+
+        if (zx * zx + zy * zy > 4.0f) {
+            break;
+        }
+
+        if (periodic) {
+            if (zx == rx && zy == ry) {
+                n = maxIter;
+                break;
+            }
+            if ((n & (n + 1)) == 0) {
+                rx = zx;
+                ry = zy;
+            }
+        }
+    }
+
+    if (last) {
+        last[0] = zx;
+        last[1] = zy;
+    }
+    if (n < maxIter) {
+        return n;
+    }
+    return maxIter > 0 ? maxIter - 1 : 0;
+}
+
+/**
+ * Iterate z = z^2 - c from z = 0 for the point c = (cx, cy) and return the
+ * iteration on which |z| first exceeds 2, or maxIter - 1 if it never does.
+ * Comparing |z|^2 against 4 gives the same answer as comparing |z| against 2
+ * without the square root. Honours mandelbrot_setShortcuts().
+ */
+int mandelbrot_escape(float cx, float cy, int maxIter) {
+    if ((mandelbrot_flags & MANDELBROT_INTERIOR) && mandelbrot_interior(cx, cy)) {
+        return maxIter > 0 ? maxIter - 1 : 0;
+    }
+
+    return mandelbrot_iterate(cx, cy, maxIter,
+                              mandelbrot_flags & MANDELBROT_PERIODICITY, NULL);
+}
+
+#ifdef MANDELBROT_SIMD
+/* Lanes set in skip are already known to be interior and start inactive. If
+lastX is not NULL, lastX and lastY receive each lane's final z. */
+__attribute__((target("avx2"), optimize("fp-contract=off")))
+static void mandelbrot_escape8(const float *cx, const float *cy, int maxIter,
+                               int skip, int periodic, int *counts,
+                               float *lastX, float *lastY) {
+    __m256 x = _mm256_loadu_ps(cx);
+    __m256 y = _mm256_loadu_ps(cy);
+    __m256 zx = _mm256_setzero_ps();
+    __m256 zy = _mm256_setzero_ps();
+    __m256 rx = _mm256_setzero_ps();
+    __m256 ry = _mm256_setzero_ps();
+    __m256 two = _mm256_set1_ps(2.0f);
+    __m256 four = _mm256_set1_ps(4.0f);
+    __m256i lane = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256 active = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+                        _mm256_and_si256(_mm256_set1_epi32(skip), lane),
+                        _mm256_setzero_si256()));
+    __m256i iters = _mm256_set1_epi32(maxIter - 1);
+
+    for (int n = 0; n < maxIter; n++) {
+        if (_mm256_testz_ps(active, active)) {
+            break;
+        }
+
+        __m256 nzx = _mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(zx, zx),
+                                                 _mm256_mul_ps(zy, zy)), x);
+        __m256 nzy = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(two, zx), zy), y);
+        __m256 mag = _mm256_add_ps(_mm256_mul_ps(nzx, nzx),
+                                   _mm256_mul_ps(nzy, nzy));
+        __m256 escaped = _mm256_and_ps(active,
+                                       _mm256_cmp_ps(mag, four, _CMP_GT_OQ));
+
+        // Escaped lanes record n and freeze on their escaped z; the rest carry on
+        iters = _mm256_castps_si256(_mm256_blendv_ps(
+                    _mm256_castsi256_ps(iters),
+                    _mm256_castsi256_ps(_mm256_set1_epi32(n)), escaped));
+        zx = _mm256_blendv_ps(zx, nzx, active);
+        zy = _mm256_blendv_ps(zy, nzy, active);
+        active = _mm256_andnot_ps(escaped, active);
+
+        // Lanes whose orbit repeats keep maxIter - 1 and stop
+        if (periodic) {
+            __m256 same = _mm256_and_ps(_mm256_cmp_ps(zx, rx, _CMP_EQ_OQ),
+                                        _mm256_cmp_ps(zy, ry, _CMP_EQ_OQ));
+            active = _mm256_andnot_ps(same, active);
+            if ((n & (n + 1)) == 0) {
+                rx = zx;
+                ry = zy;
+            }
+        }
+    }
+
+    _mm256_storeu_si256((__m256i *) counts, iters);
+    if (lastX) {
+        _mm256_storeu_ps(lastX, zx);
+        _mm256_storeu_ps(lastY, zy);
+    }
+}
+
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static void mandelbrot_escape16(const float *cx, const float *cy, int maxIter,
+                                int skip, int periodic, int *counts,
+                                float *lastX, float *lastY) {
+    __m512 x = _mm512_loadu_ps(cx);
+    __m512 y = _mm512_loadu_ps(cy);
+    __m512 zx = _mm512_setzero_ps();
+    __m512 zy = _mm512_setzero_ps();
+    __m512 rx = _mm512_setzero_ps();
+    __m512 ry = _mm512_setzero_ps();
+    __m512 two = _mm512_set1_ps(2.0f);
+    __m512 four = _mm512_set1_ps(4.0f);
+    __mmask16 active = (__mmask16) ~skip;
+    __m512i iters = _mm512_set1_epi32(maxIter - 1);
+
+    for (int n = 0; n < maxIter; n++) {
+        if (!active) {
+            break;
+        }
+
+        __m512 nzx = _mm512_sub_ps(_mm512_sub_ps(_mm512_mul_ps(zx, zx),
+                                                 _mm512_mul_ps(zy, zy)), x);
+        __m512 nzy = _mm512_sub_ps(_mm512_mul_ps(_mm512_mul_ps(two, zx), zy), y);
+        __m512 mag = _mm512_add_ps(_mm512_mul_ps(nzx, nzx),
+                                   _mm512_mul_ps(nzy, nzy));
+        __mmask16 escaped = _mm512_mask_cmp_ps_mask(active, mag, four,
+                                                    _CMP_GT_OQ);
+
+        iters = _mm512_mask_mov_epi32(iters, escaped, _mm512_set1_epi32(n));
+        zx = _mm512_mask_mov_ps(zx, active, nzx);
+        zy = _mm512_mask_mov_ps(zy, active, nzy);
+        active &= ~escaped;
+
+        if (periodic) {
+            active &= ~(_mm512_cmp_ps_mask(zx, rx, _CMP_EQ_OQ) &
+                        _mm512_cmp_ps_mask(zy, ry, _CMP_EQ_OQ));
+            if ((n & (n + 1)) == 0) {
+                rx = zx;
+                ry = zy;
+            }
+        }
+    }
+
+    _mm512_storeu_si512(counts, iters);
+    if (lastX) {
+        _mm512_storeu_ps(lastX, zx);
+        _mm512_storeu_ps(lastY, zy);
+    }
+}
+
+/**
+ * Bitmask of the lanes in a group of width points that are known interior.
+ */
+static int mandelbrot_interiorMask(const float *cx, const float *cy,
+                                   int width) {
+    int skip = 0;
+
+    if (mandelbrot_flags & MANDELBROT_INTERIOR) {
+        for (int l = 0; l < width; l++) {
+            skip |= mandelbrot_interior(cx[l], cy[l]) << l;
+        }
+    }
+
+    return skip;
+}
+#endif
+
+/**
+ * mandelbrot_escapeRow(), also storing the final z of each point in lastX and
+ * lastY when they are not NULL.
+ */
+static void mandelbrot_escapeRowLast(const float *cx, const float *cy, int n,
+                                     int maxIter, int *counts, float *lastX,
+                                     float *lastY) {
+    int k = 0;
+    int periodic = mandelbrot_flags & MANDELBROT_PERIODICITY;
+
+#ifdef MANDELBROT_SIMD
+    if (maxIter > 0) {
+        if (__builtin_cpu_supports("avx512f")) {
+            for (; k + 16 <= n; k += 16) {
+                int skip = mandelbrot_interiorMask(cx + k, cy + k, 16);
+                mandelbrot_escape16(cx + k, cy + k, maxIter, skip, periodic,
+                                    counts + k, lastX ? lastX + k : NULL,
+                                    lastY ? lastY + k : NULL);
+            }
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            for (; k + 8 <= n; k += 8) {
+                int skip = mandelbrot_interiorMask(cx + k, cy + k, 8);
+                mandelbrot_escape8(cx + k, cy + k, maxIter, skip, periodic,
+                                   counts + k, lastX ? lastX + k : NULL,
+                                   lastY ? lastY + k : NULL);
+            }
+        }
+    }
+#endif
+
+    for (; k < n; k++) {
+        float last[2] = {0.0f, 0.0f};
+
+        if ((mandelbrot_flags & MANDELBROT_INTERIOR) &&
+            mandelbrot_interior(cx[k], cy[k])) {
+            counts[k] = maxIter > 0 ? maxIter - 1 : 0;
+        } else {
+            counts[k] = mandelbrot_iterate(cx[k], cy[k], maxIter, periodic, last);
+        }
+        if (lastX) {
+            lastX[k] = last[0];
+            lastY[k] = last[1];
+        }
+    }
+}
+
+/**
+ * Compute mandelbrot_escape() for the n points (cx[k], cy[k]) and store the
+ * results in counts. Groups of 16 or 8 points are handed to the widest vector
+ * kernel the CPU supports; whatever is left over runs through the scalar loop.
+ */
+void mandelbrot_escapeRow(const float *cx, const float *cy, int n, int maxIter,
+                          int *counts) {
+    if (!cx || !cy || !counts) {
+        printf("mandelbrot_escapeRow(): passed NULL pointer.\n");
+        return;
+    }
+
+    mandelbrot_escapeRowLast(cx, cy, n, maxIter, counts, NULL, NULL);
+}
+
+/* Rows are rendered in parallel, one row per work item. Each worker keeps its
+own scratch buffers for the c values and iteration counts it is working on. */
+typedef struct {
+    Image *im;
+    float x0, y1; // complex coordinates of the top left pixel
+    float sx, sy; // size of a pixel in the complex plane
+    int scratch; // entries per worker in cx, cy, and counts
+    float *cx, *cy; // per-worker scratch
+    int *counts;
+    int *iters; // whole-image iteration counts (subdivision/progressive only)
+    FractalProgress progress; // progressive renders only
+    void *progressArg;
+    Palette *palette; // maps counts to colors
+    IterBuffer *buffer; // receives the counts instead of the image, if set
+    float *lastX, *lastY, *frac; // per-worker scratch for smooth counts
+} MandelbrotJob;
+
+static Palette *mandelbrot_palette = NULL; // log palette, built on first use
+
+/**
+ * Color row i of the image from the iteration counts of its pixels: log(n) in
+ * red and 1 / log(n) in blue, looked up rather than computed.
+ */
+static void mandelbrot_colorRow(MandelbrotJob *job, int i, const int *counts) {
+    const FPixel *lut = job->palette->lut;
+
+    for (int j = 0; j < job->im->cols; j++) {
+        image_setc(job->im, i, j, 0, lut[counts[j]].rgb[0]);
+        image_setc(job->im, i, j, 2, lut[counts[j]].rgb[2]);
+    }
+}
+
+static void mandelbrot_renderRow(int i, int worker, void *arg) {
+    MandelbrotJob *job = arg;
+    int cols = job->im->cols;
+    float *cx = job->cx + (size_t) worker * job->scratch;
+    float *cy = job->cy + (size_t) worker * job->scratch;
+    int *counts = job->counts + (size_t) worker * job->scratch;
+    int j;
+
+    // calculate (x, y) for every pixel (i, j) in the row
+    // this corresponds to cx and cy in the Mandelbrot equation
+    for (j = 0; j < cols; j++) {
+        cx[j] = job->sx * j + job->x0;
+        cy[j] = -job->sy * i + job->y1;
+    }
+
+    // iterate the whole row at once
+    mandelbrot_escapeRow(cx, cy, cols, ITERATIONS, counts);
+
+    // color pixel (i, j)
+    mandelbrot_colorRow(job, i, counts);
+}
+
+/**
+ * FractalBatch for the subdivision engine: iterate an arbitrary set of pixels
+ * through the same vector kernel as whole rows.
+ */
+static void mandelbrot_batch(const int *row, const int *col, int n, int worker,
+                             int *counts, void *arg) {
+    MandelbrotJob *job = arg;
+    float *cx = job->cx + (size_t) worker * job->scratch;
+    float *cy = job->cy + (size_t) worker * job->scratch;
+
+    for (int k = 0; k < n; k++) {
+        cx[k] = job->sx * col[k] + job->x0;
+        cy[k] = -job->sy * row[k] + job->y1;
+    }
+    mandelbrot_escapeRow(cx, cy, n, ITERATIONS, counts);
+}
+
+static void mandelbrot_colorIters(int i, int worker, void *arg) {
+    MandelbrotJob *job = arg;
+
+    mandelbrot_colorRow(job, i, job->iters + (size_t) i * job->im->cols);
+}
+
+/**
+ * FractalPass for progressive renders: color the preview and hand it on.
+ */
+static void mandelbrot_pass(int step, void *arg) {
+    MandelbrotJob *job = arg;
+
+    parallel_for(job->im->rows, mandelbrot_colorIters, job);
+    if (job->progress) {
+        job->progress(job->im, step, job->progressArg);
+    }
+}
+
+/**
+ * Set up job to render im, where pixel (i, j) is the point
+ * (sx * j + x0, -sy * i + y1). whole requests a whole-image iteration count
+ * buffer, which the subdivision, progressive, and cached renders work in.
+ * Returns 0, or -1 if allocation fails (job is still safe to free).
+ */
+static int mandelbrot_jobInit(MandelbrotJob *job, Image *im, float x0, float y1,
+                              float sx, float sy, int whole) {
+    size_t n;
+
+    job->im = im;
+    job->x0 = x0;
+    job->y1 = y1;
+    job->sx = sx;
+    job->sy = sy;
+    job->progress = NULL;
+    job->progressArg = NULL;
+    if (!mandelbrot_palette) {
+        mandelbrot_palette = palette_createLog(ITERATIONS, 2);
+    }
+    job->palette = mandelbrot_palette;
+    job->buffer = NULL;
+    job->lastX = NULL;
+    job->lastY = NULL;
+    job->frac = NULL;
+    job->scratch = im->cols;
+    if (whole && job->scratch < FRACTAL_TILE * FRACTAL_TILE) {
+        job->scratch = FRACTAL_TILE * FRACTAL_TILE;
+    }
+    n = (size_t) parallel_threads() * job->scratch;
+    job->cx = calloc(n, sizeof(float));
+    job->cy = calloc(n, sizeof(float));
+    job->counts = calloc(n, sizeof(int));
+    job->iters = whole ? malloc(sizeof(int) * im->rows * im->cols) : NULL;
+    if (!job->cx || !job->cy || !job->counts || (whole && !job->iters) ||
+        !job->palette) {
+        printf("mandelbrot_jobInit(): calloc() failed.\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void mandelbrot_jobFree(MandelbrotJob *job) {
+    free(job->lastX);
+    free(job->lastY);
+    free(job->frac);
+    free(job->cx);
+    free(job->cy);
+    free(job->counts);
+    free(job->iters);
+}
+
+/**
+ * Render the set into every pixel of im, where pixel (i, j) is the point
+ * (sx * j + x0, -sy * i + y1), using the engine chosen with
+ * fractal_setEngine(), or the progressive engine if progressive is set. The
+ * work is spread over threads with parallel_for(). Returns 0, or
+ * FRACTAL_CANCELLED or -1 as fractal_progressive() does.
+ */
+static int mandelbrot_render(Image *im, float x0, float y1, float sx, float sy,
+                             int progressive, FractalProgress progress,
+                             void *arg, FractalCancel *cancel) {
+    MandelbrotJob job;
+    int subdivide = fractal_engine() == EngineSubdivide;
+    int result = -1;
+
+    if (mandelbrot_jobInit(&job, im, x0, y1, sx, sy, subdivide || progressive)) {
+        mandelbrot_jobFree(&job);
+        return -1;
+    }
+
+    if (progressive) {
+        job.progress = progress;
+        job.progressArg = arg;
+        result = fractal_progressive(im->rows, im->cols, job.iters,
+                                     mandelbrot_batch, mandelbrot_pass, &job,
+                                     cancel);
+    } else if (subdivide) {
+        if (fractal_subdivide(im->rows, im->cols, job.iters, mandelbrot_batch,
+                              &job) >= 0) {
+            parallel_for(im->rows, mandelbrot_colorIters, &job);
+            result = 0;
+        }
+    } else {
+        parallel_for(im->rows, mandelbrot_renderRow, &job);
+        result = 0;
+    }
+    mandelbrot_jobFree(&job);
+
+    return result;
+}
+
+/**
+ * Render im from the fractal tile cache, snapping the view to the grid of
+ * pixel-sized steps so tiles line up between pans. Pixel (i, j) becomes the
+ * grid point nearest (pixel * j + x0, -pixel * i + y1). Returns -1, leaving
+ * the image untouched, if the cache is disabled or the view is too far from
+ * the origin to be addressed on the grid.
+ */
+static int mandelbrot_renderCached(Image *im, float x0, float y1, float pixel) {
+    MandelbrotJob job;
+    FractalParams params = {FRACTAL_MANDELBROT, ITERATIONS, 0.0, 0.0};
+    double col0 = floor(x0 / pixel + 0.5), row0 = floor(-y1 / pixel + 0.5);
+    int result = -1;
+
+    if (fractal_cacheLimit() == 0 || !(pixel > 0.0) ||
+        fabs(col0) > INT_MAX / 2 - im->cols || fabs(row0) > INT_MAX / 2 - im->rows) {
+        return -1;
+    }
+
+    // Batches arrive in grid coordinates
+    if (mandelbrot_jobInit(&job, im, 0.0, 0.0, pixel, pixel, 1) == 0 &&
+        fractal_cached(im->rows, im->cols, (int) row0, (int) col0, pixel,
+                       &params, job.iters, mandelbrot_batch, &job) >= 0) {
+        parallel_for(im->rows, mandelbrot_colorIters, &job);
+        result = 0;
+    }
+    mandelbrot_jobFree(&job);
+
+    return result;
+}
+
 /**
  * Easy to use version of mandelbrot. This function takes two points in the 
  * complex plane (x0, y0) and (x1, y1) which define a rectangle. It then creates
@@ -29,14 +532,12 @@
  * algorithm for a set number of iterations for every pixel in the image,
  * coloring each based on which iteration it diverges at. This allows the user
  * to easily specify what area and resolution is to be rendered of the
- * mandelbrot set.
+ * mandelbrot set. Rows are computed in parallel.
  */
 Image *image_mandelbrot(float x0, float y0, float x1, float y1, int rows) {
     Image *im;
     int cols;
-    float sCols, sRows, zx, zy, zx_temp, zy_temp, x, y;
-    int i, j, n;
-    int numIters;
+    float sCols, sRows;
     
     // calculate the number of columns 
     cols = ((x1 - x0) * rows) / (y1 - y0);
@@ -48,39 +549,8 @@ Image *image_mandelbrot(float x0, float y0, float x1, float y1, int rows) {
     sCols = (x1 - x0) / cols;
     sRows = (y1 - y0) / rows;
 
-    // for each pixel in the image (i, j)
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            // calculate (x, y) given (i, j)
-            // this corresponds to cx and cy in the Mandelbrot equation
-            x = sCols * j + x0;
-            y = -sRows * i + y1;
-            
-            // set zx and zy to (0, 0)
-            zx = 0;
-            zy = 0;
-
-            // for some number of iterations up to N (e.g. 100)
-            for (n = 0; n < ITERATIONS; n++) {
-                // iterate the Mandelbrot equation
-                zx_temp = zx * zx - zy * zy - x;
-                zy_temp = 2 * zx * zy - y;
-                zx = zx_temp;
-                zy = zy_temp;
-
-                // if the length of z is greater than 2.0,
-                if (sqrt(zx * zx + zy * zy) > 2) {
-                    numIters = n;
-                    break;
-                }
-
-                numIters = n;
-            }
-            // color pixel (i, j)
-            image_setc(im, i, j, 0, log((double) numIters));
-            image_setc(im, i, j, 2, 1.0 / log(((double) numIters)));
-        }
-    }
+    // compute every pixel (i, j), a row at a time
+    mandelbrot_render(im, x0, y1, sCols, sRows, 0, NULL, NULL, NULL);
 
     // return the image
     return(im);
@@ -99,16 +569,13 @@ Image *image_mandelbrot(float x0, float y0, float x1, float y1, int rows) {
  * This internal computation of height can make it a cumbersome tool to use
  * interactively, but would be useful if implementing a program where we wished
  * to pan about or zoom the set interactively within a window (say, a screen) of
- * a fixed size.
+ * a fixed size. For that use, turn on the fractal tile cache with
+ * fractal_setCacheLimit(): panning then only computes newly exposed tiles.
  */
 void mandelbrot(Image *im, float x0, float y0, float dx) {
     image_reset(im);
     int cols = im->cols;
     int rows = im->rows;
-    
-    float zx, zy, zx_temp, zy_temp, x, y;
-    int i, j, n;
-    int numIters;
 
     // Compute pixel width
     float pixelwidth = dx / cols;
@@ -116,43 +583,135 @@ void mandelbrot(Image *im, float x0, float y0, float dx) {
     // compute height of the complex rectangle
     float height = pixelwidth * rows;
 
-    // Compute x1 and y1
-    float x1 = x0 + dx;
+    // Compute y1
     float y1 = y0 + height;
 
-    // for each pixel in the image (i, j)
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            // calculate (x, y) given (i, j)
-            // this corresponds to cx and cy in the Mandelbrot equation
-            x = pixelwidth * j + x0;
-            y = -pixelwidth * i + y1;
-            
-            // set zx and zy to (0, 0)
-            zx = 0;
-            zy = 0;
-
-            // for some number of iterations up to N (e.g. 100)
-            for (n = 0; n < ITERATIONS; n++) {
-                // iterate the Mandelbrot equation
-                zx_temp = (zx * zx) - (zy * zy) - x;
-                zy_temp = 2 * zx * zy - y;
-                zx = zx_temp;
-                zy = zy_temp;
-
-                // if the length of z is greater than 2.0,
-                if (sqrt(zx * zx + zy * zy) > 2) {
-                    numIters = n;
-                    break;
-                }
-
-                numIters = n;
-            }
-            // color pixel (i, j)
-            image_setc(im, i, j, 0, log((double) numIters));
-            image_setc(im, i, j, 2, 1.0 / log(((double) numIters)));
+    // reuse cached tiles if the cache is on, else compute every pixel (i, j)
+    if (mandelbrot_renderCached(im, x0, y1, pixelwidth)) {
+        mandelbrot_render(im, x0, y1, pixelwidth, pixelwidth, 0, NULL, NULL, NULL);
+    }
+}
+
+/**
+ * Progressive version of image_mandelbrot(). The image is first computed at
+ * every FRACTAL_COARSE_STEP-th pixel and then refined in passes, and
+ * progress (which may be NULL) is called with the image after each pass, so
+ * an interactive program can show a preview long before the render finishes.
+ * If cancel is cancelled from another thread, the render stops early and the
+ * image is returned with whatever passes were finished; check
+ * fractal_cancelled() to tell. The final image is identical to
+ * image_mandelbrot()'s.
+ */
+Image *image_mandelbrotProgressive(float x0, float y0, float x1, float y1,
+                                   int rows, FractalProgress progress,
+                                   void *arg, FractalCancel *cancel) {
+    Image *im;
+    int cols;
+
+    cols = ((x1 - x0) * rows) / (y1 - y0);
+    im = image_create(rows, cols);
+    if (im) {
+        mandelbrot_render(im, x0, y1, (x1 - x0) / cols, (y1 - y0) / rows, 1,
+                          progress, arg, cancel);
+    }
+    return(im);
+}
+
+/**
+ * Progressive version of mandelbrot(), with progress, arg, and cancel as for
+ * image_mandelbrotProgressive(). Returns 0 once the image is complete,
+ * FRACTAL_CANCELLED if the render was cancelled, or -1 on failure.
+ */
+int mandelbrot_progressive(Image *im, float x0, float y0, float dx,
+                           FractalProgress progress, void *arg,
+                           FractalCancel *cancel) {
+    if (!im) {
+        printf("mandelbrot_progressive(): passed NULL pointer.\n");
+        return -1;
+    }
+
+    image_reset(im);
+    float pixelwidth = dx / im->cols;
+    float y1 = y0 + pixelwidth * im->rows;
+
+    return mandelbrot_render(im, x0, y1, pixelwidth, pixelwidth, 1, progress,
+                             arg, cancel);
+}
+
+/**
+ * Store the counts of row i of the view in the job's IterBuffer, with the
+ * fractions of a smooth buffer.
+ */
+static void mandelbrot_countRow(int i, int worker, void *arg) {
+    MandelbrotJob *job = arg;
+    int cols = job->buffer->cols;
+    size_t offset = (size_t) worker * job->scratch;
+    float *cx = job->cx + offset, *cy = job->cy + offset;
+    int *counts = job->counts + offset;
+
+    for (int j = 0; j < cols; j++) {
+        cx[j] = job->sx * j + job->x0;
+        cy[j] = -job->sy * i + job->y1;
+    }
+
+    if (job->buffer->smooth) {
+        float *lastX = job->lastX + offset, *lastY = job->lastY + offset;
+        float *frac = job->frac + offset;
+
+        mandelbrot_escapeRowLast(cx, cy, cols, ITERATIONS, counts, lastX, lastY);
+        for (int j = 0; j < cols; j++) {
+            frac[j] = iterbuffer_smooth(lastX[j], lastY[j]);
         }
+        iterbuffer_setRow(job->buffer, i, counts, frac);
+    } else {
+        mandelbrot_escapeRow(cx, cy, cols, ITERATIONS, counts);
+        iterbuffer_setRow(job->buffer, i, counts, NULL);
     }
 }
 
+/**
+ * Compute the iteration counts of the view mandelbrot() would draw into an
+ * image the size of b, storing them in b (with fractions if b is smooth)
+ * rather than coloring an image. Color them with palette_apply(), as often
+ * as desired. Rows are computed in parallel. Returns 0, or -1 on failure.
+ */
+int mandelbrot_iterations(IterBuffer *b, float x0, float y0, float dx) {
+    MandelbrotJob job;
+    Image view; // only its size is used
+    float pixelwidth;
+    size_t n;
+    int result = -1;
+
+    if (!b) {
+        printf("mandelbrot_iterations(): passed NULL pointer.\n");
+        return -1;
+    }
+    if (b->maxIter < ITERATIONS) {
+        printf("mandelbrot_iterations(): buffer holds fewer than %d iterations.\n",
+               ITERATIONS);
+        return -1;
+    }
 
+    view.rows = b->rows;
+    view.cols = b->cols;
+    pixelwidth = dx / b->cols;
+    if (mandelbrot_jobInit(&job, &view, x0, y0 + pixelwidth * b->rows,
+                           pixelwidth, pixelwidth, 0) == 0) {
+        job.buffer = b;
+        n = (size_t) parallel_threads() * job.scratch;
+        if (b->smooth) {
+            job.lastX = malloc(sizeof(float) * n);
+            job.lastY = malloc(sizeof(float) * n);
+            job.frac = malloc(sizeof(float) * n);
+        }
+        if (!b->smooth || (job.lastX && job.lastY && job.frac)) {
+            parallel_for(b->rows, mandelbrot_countRow, &job);
+            result = 0;
+        } else {
+            printf("mandelbrot_iterations(): malloc() failed.\n");
+        }
+    }
+    mandelbrot_jobFree(&job);
+
+    return result;
+}
@@ -161,6 +161,42 @@ void matrix_copy(Matrix *dest, Matrix *src) {
     dest->m[3][3] = src->m[3][3];
 }
 
+/**
+ * Set n to the inverse transpose of the upper left 3x3 of m, with no
+ * translation or perspective. This is the matrix that transforms surface
+ * normals, and its transpose is the inverse of m's linear part. n may be m.
+ * Returns 0, or -1 if the 3x3 is singular, in which case n gets its linear
+ * part unchanged.
+ */
+int matrix_inverseTranspose(Matrix *m, Matrix *n) {
+    Matrix t;
+    double det;
+
+    if (!m || !n) {
+        printf("matrix_inverseTranspose(): passed NULL arguments.\n");
+        return -1;
+    }
+
+    det = m->m[0][0] * (m->m[1][1] * m->m[2][2] - m->m[1][2] * m->m[2][1]) -
+          m->m[0][1] * (m->m[1][0] * m->m[2][2] - m->m[1][2] * m->m[2][0]) +
+          m->m[0][2] * (m->m[1][0] * m->m[2][1] - m->m[1][1] * m->m[2][0]);
+
+    matrix_identity(&t);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            // The cofactor of (r, c), with the cyclic order giving its sign
+            int r1 = (r + 1) % 3, r2 = (r + 2) % 3;
+            int c1 = (c + 1) % 3, c2 = (c + 2) % 3;
+            double cofactor = m->m[r1][c1] * m->m[r2][c2] -
+                              m->m[r1][c2] * m->m[r2][c1];
+            t.m[r][c] = det != 0.0 ? cofactor / det : m->m[r][c];
+        }
+    }
+
+    matrix_copy(n, &t);
+    return det != 0.0 ? 0 : -1;
+}
+
 /**
  * Transpose the matrix m in place.
  */
@@ -369,6 +405,30 @@ void matrix_xformPolygon(Matrix *m, Polygon *p) {
 
 }
 
+/**
+ * Transform the points of Polygon p by the Matrix m and its surface normals,
+ * if they exist, by the Matrix normal, which should be the inverse transpose
+ * of m from matrix_inverseTranspose(). Unlike transforming the normals by m
+ * itself, this keeps them perpendicular to the polygon when m scales
+ * unevenly or shears. normal only has to be computed once for every polygon
+ * transformed by m.
+ */
+void matrix_xformPolygonNormal(Matrix *m, Matrix *normal, Polygon *p) {
+    if (!m || !normal || !p) {
+        printf("matrix_xformPolygonNormal(): passed NULL arguments.\n");
+        return;
+    }
+
+    for (int i = 0; i < p->nVertex; i++) {
+        matrix_xformPoint(m, &(p->vertex[i]), &(p->vertex[i]));
+    }
+    if (p->normal) {
+        for (int i = 0; i < p->nVertex; i++) {
+            matrix_xformVector(normal, &(p->normal[i]), &(p->normal[i]));
+        }
+    }
+}
+
 /**
  * Transform all the Points in the Polyline p by the Matrix m.
  */
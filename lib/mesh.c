@@ -0,0 +1,336 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Implements mesh.h, an indexed triangle mesh with shared vertices and
+ * per-vertex normals.
+ */
+#include "graphicslib.h"
+
+/**
+ * Allocate a Mesh with room for the given number of vertices, triangles, and
+ * edges. Arrays with a count of zero are left NULL.
+ */
+Mesh *mesh_create(int nVertex, int nTriangle, int nEdge) {
+    Mesh *m = malloc(sizeof(Mesh));
+    if (!m) {
+        printf("mesh_create(): malloc() failed.\n");
+        return NULL;
+    }
+
+    m->nVertex = nVertex;
+    m->nTriangle = nTriangle;
+    m->nEdge = nEdge;
+    m->vertex = nVertex > 0 ? malloc(sizeof(Point) * nVertex) : NULL;
+    m->normal = nVertex > 0 ? malloc(sizeof(Vector) * nVertex) : NULL;
+    m->triangle = nTriangle > 0 ? malloc(sizeof(int) * 3 * nTriangle) : NULL;
+    m->edge = nEdge > 0 ? malloc(sizeof(int) * 2 * nEdge) : NULL;
+    m->solid = 1;
+    m->oneSided = 0;
+    m->zBuffer = 1;
+    m->refCount = 1;
+
+    if ((nVertex > 0 && (!m->vertex || !m->normal)) ||
+        (nTriangle > 0 && !m->triangle) || (nEdge > 0 && !m->edge)) {
+        printf("mesh_create(): malloc() failed.\n");
+        mesh_free(m);
+        return NULL;
+    }
+
+    return m;
+}
+
+/**
+ * Add an owner to the Mesh and return it. Every mesh_retain() must be matched
+ * by a mesh_free().
+ */
+Mesh *mesh_retain(Mesh *m) {
+    if (!m) {
+        printf("mesh_retain(): passed NULL pointer.\n");
+        return NULL;
+    }
+
+    m->refCount++;
+    return m;
+}
+
+/**
+ * Drop one owner of the Mesh, freeing it and all of its arrays once no owners
+ * remain.
+ */
+void mesh_free(Mesh *m) {
+    if (!m) {
+        printf("mesh_free(): passed NULL pointer.\n");
+        return;
+    }
+    if (--m->refCount > 0) {
+        return;
+    }
+
+    free(m->vertex);
+    free(m->normal);
+    free(m->triangle);
+    free(m->edge);
+    free(m);
+}
+
+/**
+ * Return the approximate number of bytes of memory used by the Mesh.
+ */
+size_t mesh_size(Mesh *m) {
+    if (!m) {
+        printf("mesh_size(): passed NULL pointer.\n");
+        return 0;
+    }
+
+    return sizeof(Mesh) + m->nVertex * (sizeof(Point) + sizeof(Vector)) +
+           m->nTriangle * 3 * sizeof(int) + m->nEdge * 2 * sizeof(int);
+}
+
+/*
+    Clip a line in homogeneous screen coordinates to the near and far planes
+    of cv. The line must not lie entirely beyond either plane.
+ */
+static void clipEdge(Line *l, ClipVolume *cv) {
+    double ha = l->a.val[3];
+    double hb = l->b.val[3];
+    double dNear[2] = {ha - cv->hNear, hb - cv->hNear};
+    double dFar[2] = {cv->hFar - ha, cv->hFar - hb};
+    double t0 = 0.0;
+    double t1 = 1.0;
+    Point a = l->a;
+
+    if (dNear[0] < 0.0) {
+        t0 = fmax(t0, dNear[0] / (dNear[0] - dNear[1]));
+    } else if (dNear[1] < 0.0) {
+        t1 = fmin(t1, dNear[0] / (dNear[0] - dNear[1]));
+    }
+    if (dFar[0] < 0.0) {
+        t0 = fmax(t0, dFar[0] / (dFar[0] - dFar[1]));
+    } else if (dFar[1] < 0.0) {
+        t1 = fmin(t1, dFar[0] / (dFar[0] - dFar[1]));
+    }
+
+    for (int k = 0; k < 4; k++) {
+        double d = l->b.val[k] - a.val[k];
+        l->a.val[k] = a.val[k] + t0 * d;
+        l->b.val[k] = a.val[k] + t1 * d;
+    }
+}
+
+/*
+    Flat shade every triangle of the mesh once, at its centroid and with its
+    face normal, given the world coordinate vertices. The triangles are
+    shaded together, so they share lighting_shadeVertices()' batches.
+    Returns 0, or -1 on failure.
+ */
+static int shadeTriangles(Mesh *m, Point *vertex, Lighting *lighting,
+                          DrawState *ds, Color *color) {
+    Point *centroid = malloc(sizeof(Point) * m->nTriangle);
+    Vector *face = malloc(sizeof(Vector) * m->nTriangle);
+    Polygon tri;
+
+    if (!centroid || !face) {
+        printf("mesh_draw(): malloc() failed.\n");
+        free(centroid);
+        free(face);
+        return -1;
+    }
+
+    polygon_init(&tri);
+    for (int i = 0; i < m->nTriangle; i++) {
+        Point v[3];
+        for (int k = 0; k < 3; k++) {
+            v[k] = vertex[m->triangle[i*3 + k]];
+        }
+        point_set3D(&centroid[i],
+                    (v[0].val[0] + v[1].val[0] + v[2].val[0]) / 3.0,
+                    (v[0].val[1] + v[1].val[1] + v[2].val[1]) / 3.0,
+                    (v[0].val[2] + v[1].val[2] + v[2].val[2]) / 3.0);
+        tri.nVertex = 3;
+        tri.vertex = v;
+        polygon_faceNormal(&tri, &face[i]);
+    }
+    lighting_shadeVertices(lighting, m->nTriangle, centroid, face, ds, 0,
+                           color);
+
+    free(centroid);
+    free(face);
+    return 0;
+}
+
+/**
+ * Transform every shared vertex of the mesh by VTM * world once, then draw
+ * the mesh into src. Solid meshes are drawn triangle by triangle with
+ * polygon_drawFill, which honours the DrawState's shading method. They are
+ * lit in world coordinates with lighting: for ShadeGouraud each shared
+ * vertex is lit once, and for ShadeFlat each triangle. Wireframe meshes draw
+ * each of their edges once using the DrawState's color.
+ *
+ * Triangles of a oneSided mesh that face away from the viewer are skipped, as
+ * module_draw() does for one-sided polygons. Meshes default to two-sided
+ * because a single Bezier patch is an open surface; module_teapot() leaves
+ * its patches two-sided too, since the teapot has no bottom and an open
+ * spout. Returns the number of triangles skipped as back faces.
+ */
+int mesh_draw(Mesh *m, Matrix *VTM, Matrix *world, DrawState *ds,
+              Lighting *lighting, Image *src) {
+    int backFaces = 0;
+
+    if (!m || !VTM || !world || !ds || !src) {
+        printf("mesh_draw(): passed NULL pointer.\n");
+        return 0;
+    }
+    // Wireframe meshes leave nothing in a depth-only pass
+    if (m->nVertex <= 0 || (!m->solid && ds->shade == ShadeDepthOnly)) {
+        return 0;
+    }
+
+    /* Keep both the homogeneous and normalized position of each vertex:
+    triangles inside the view volume only need the latter, while triangles
+    crossing it are clipped from the former */
+    Point *homogeneous = malloc(sizeof(Point) * m->nVertex);
+    Point *screen = malloc(sizeof(Point) * m->nVertex);
+    Vector *normal = malloc(sizeof(Vector) * m->nVertex);
+    int *outcode = malloc(sizeof(int) * m->nVertex);
+    int lit = m->solid && lighting &&
+              (ds->shade == ShadeFlat || ds->shade == ShadeGouraud);
+    int flat = lit && ds->shade == ShadeFlat;
+    // Vertex colors, or for flat shading triangle colors
+    Color *color = lit ? malloc(sizeof(Color) *
+                                (flat ? m->nTriangle : m->nVertex)) : NULL;
+    if (!homogeneous || !screen || !normal || !outcode || (lit && !color)) {
+        printf("mesh_draw(): malloc() failed.\n");
+        free(homogeneous);
+        free(screen);
+        free(normal);
+        free(outcode);
+        free(color);
+        return 0;
+    }
+
+    ClipVolume clip;
+    clipvolume_set(&clip, src, ds);
+    if (!m->solid || ds->shade == ShadeFrame) {
+        clip.planes = CLIP_NEAR | CLIP_FAR;
+    }
+
+    /* The vertices go to world coordinates first (screen[] holds them
+    there) so they can be lit, then on to the screen. Normals take the
+    inverse transpose so they stay perpendicular under uneven scales */
+    Matrix normalTM;
+    matrix_inverseTranspose(world, &normalTM);
+    for (int i = 0; i < m->nVertex; i++) {
+        matrix_xformPoint(world, &(m->vertex[i]), &screen[i]);
+        matrix_xformVector(&normalTM, &(m->normal[i]), &normal[i]);
+    }
+    if (flat && shadeTriangles(m, screen, lighting, ds, color)) {
+        lit = flat = 0;
+    } else if (lit && !flat) {
+        lighting_shadeVertices(lighting, m->nVertex, screen, normal, ds, 0,
+                               color);
+    }
+    for (int i = 0; i < m->nVertex; i++) {
+        matrix_xformPoint(VTM, &screen[i], &homogeneous[i]);
+        outcode[i] = point_outcode(&homogeneous[i], &clip);
+        screen[i] = homogeneous[i];
+        point_normalize(&screen[i]);
+    }
+
+    if (m->solid) {
+        int cull = m->oneSided && ds->shade != ShadeFrame;
+        // One 3-vertex polygon on the stack is reused for every triangle
+        Point v[3];
+        Vector n[3];
+        Color col[3] = {ds->color, ds->color, ds->color};
+        Color fill = ds->color;
+        Polygon p;
+        polygon_init(&p);
+        p.oneSided = m->oneSided;
+        p.nVertex = 3;
+        p.vertex = v;
+        p.normal = n;
+        p.color = col;
+        p.zBuffer = m->zBuffer;
+
+        for (int i = 0; i < m->nTriangle; i++) {
+            int *tri = &m->triangle[i*3];
+            int orCode = outcode[tri[0]] | outcode[tri[1]] | outcode[tri[2]];
+            int andCode = outcode[tri[0]] & outcode[tri[1]] & outcode[tri[2]];
+
+            if (andCode) {
+                continue;
+            }
+            if (flat) {
+                fill = color[i];
+            } else if (lit) {
+                for (int k = 0; k < 3; k++) {
+                    col[k] = color[tri[k]];
+                }
+            }
+            if (orCode) {
+                // Crossing the view volume: clip a heap copy of the triangle
+                Polygon *c = polygon_create();
+                c->oneSided = m->oneSided;
+                c->zBuffer = m->zBuffer;
+                c->nVertex = 3;
+                c->vertex = malloc(sizeof(Point) * 3);
+                c->normal = malloc(sizeof(Vector) * 3);
+                c->color = malloc(sizeof(Color) * 3);
+                for (int k = 0; k < 3; k++) {
+                    c->vertex[k] = homogeneous[tri[k]];
+                    c->normal[k] = normal[tri[k]];
+                    c->color[k] = col[k];
+                }
+                if (polygon_clip(c, &clip)) {
+                    polygon_normalize(c);
+                    if (cull && polygon_backFacing(c)) {
+                        backFaces++;
+                    } else {
+                        polygon_drawFill(c, src, fill, ds);
+                    }
+                }
+                polygon_free(c);
+                continue;
+            }
+
+            for (int k = 0; k < 3; k++) {
+                v[k] = screen[tri[k]];
+                n[k] = normal[tri[k]];
+            }
+            if (cull && polygon_backFacing(&p)) {
+                backFaces++;
+                continue;
+            }
+            polygon_drawFill(&p, src, fill, ds);
+        }
+    } else {
+        Line l;
+        l.zBuffer = m->zBuffer;
+        for (int i = 0; i < m->nEdge; i++) {
+            int a = m->edge[i*2];
+            int b = m->edge[i*2 + 1];
+
+            if (outcode[a] & outcode[b]) {
+                continue;
+            }
+            if (outcode[a] | outcode[b]) {
+                l.a = homogeneous[a];
+                l.b = homogeneous[b];
+                clipEdge(&l, &clip);
+                line_normalize(&l);
+            } else {
+                l.a = screen[a];
+                l.b = screen[b];
+            }
+            line_draw(&l, src, ds->color);
+        }
+    }
+
+    free(homogeneous);
+    free(screen);
+    free(normal);
+    free(outcode);
+    free(color);
+
+    return backFaces;
+}
@@ -6,10 +6,30 @@
  * provides the module_draw() function to traverse the graph and draw it
  * according to a user specified view.
  */
+#include <stdatomic.h>
+#include <string.h>
 #include "modeling.h"
 
+/* Clock handing out change stamps, so a Module changed later always has a
+larger stamp. Starts at 1 so that a stamp of 0 is never current */
+static atomic_ulong moduleClock = 1;
+
+/* Running totals reported by module_stats() */
+static atomic_long statPolygons;
+static atomic_long statBackFaces;
+static atomic_long statClipped;
+static atomic_long statModules;
+
 /* 2D AND GENERIC MODULE FUNCTIONS */
 
+/*
+    Record that the module's contents changed, which invalidates the cached
+    bounding boxes of the module and every module that includes it.
+ */
+static void moduleChanged(Module *md) {
+    md->changed = atomic_fetch_add(&moduleClock, 1) + 1;
+}
+
 /**
  * Allocate and return an initialized but empty Element.
  */
@@ -95,6 +115,7 @@ Element *element_init(ObjectType type, void *obj) {
 
     case ObjLight:
         toReturn->type = ObjLight;
+        toReturn->obj.light = *((Light *) obj);
         break;
 
     case ObjModule:
@@ -107,6 +128,11 @@ Element *element_init(ObjectType type, void *obj) {
         bezierCurve_copy(&(toReturn->obj.curve), ((BezierCurve *) obj));
         break;
 
+    case ObjMesh:
+        toReturn->type = ObjMesh;
+        toReturn->obj.mesh = obj; // The Element owns one reference to the Mesh
+        break;
+
     default:
         printf("element_init(): passed unknown object type\n");
         free(toReturn);
@@ -137,6 +163,11 @@ void element_delete(Element *e) {
         free(e);
         break;
 
+    case ObjMesh:
+        mesh_free(e->obj.mesh);
+        free(e);
+        break;
+
     default:
         free(e);
         break;
@@ -151,6 +182,8 @@ Module *module_create(void) {
     Module *toReturn = malloc(sizeof(Module));
     toReturn->head = NULL;
     toReturn->tail = NULL;
+    toReturn->boundsStamp = 0;
+    moduleChanged(toReturn);
     return toReturn;
 }
 
@@ -172,6 +205,7 @@ void module_clear(Module *md) {
     }
     md->head = NULL;
     md->tail = NULL;
+    moduleChanged(md);
 }
 
 void module_free(Module *md) {
@@ -193,6 +227,7 @@ void module_free(Module *md) {
     }
     md->head = NULL;
     md->tail = NULL;
+    moduleChanged(md);
 }
 
 /**
@@ -227,6 +262,8 @@ void module_insert(Module *md, Element *e) {
         md->tail->next = e; // Set the last element in the list to point to e
         md->tail = e; // Set the last element to be e.
     }
+
+    moduleChanged(md);
 }
 
 /**
@@ -238,13 +275,7 @@ void module_module(Module *md, Module *sub) {
         return;
     }
     Element *e = element_init(ObjModule, sub);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -257,13 +288,7 @@ void module_point(Module *md, Point *p) {
     }
 
     Element *e = element_init(ObjPoint, p);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -276,13 +301,7 @@ void module_line(Module *md, Line *p) {
     }
 
     Element *e = element_init(ObjLine, p);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -295,13 +314,7 @@ void module_polyline(Module *md, Polyline *p) {
     }
 
     Element *e = element_init(ObjPolyline, p);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -314,13 +327,7 @@ void module_polygon(Module *md, Polygon *p) {
     }
 
     Element *e = element_init(ObjPolygon, p);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -338,13 +345,7 @@ void module_identity(Module *md) {
 
     Element *e = element_init(ObjIdentity, m);
     free(m);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -362,13 +363,7 @@ void module_translate2D(Module *md, double tx, double ty) {
 
     Element *e = element_init(ObjMatrix, m);
     free(m);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -387,13 +382,7 @@ void module_scale2D(Module *md, double sx, double sy) {
     Element *e = element_init(ObjMatrix, m);
     free(m);
 
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -411,13 +400,7 @@ void module_rotateZ(Module *md, double cth, double sth) {
 
     Element *e = element_init(ObjMatrix, m);
     free(m);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -436,24 +419,232 @@ void module_shear2D(Module *md, double shx, double shy) {
     Element *e = element_init(ObjMatrix, m);
     free(m);
 
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
+    module_insert(md, e);
+}
+
+/*
+    Grow the box [min, max] to include the point pt transformed by m.
+ */
+static void boundsAdd(Point *min, Point *max, Matrix *m, Point *pt) {
+    Point x;
+    matrix_xformPoint(m, pt, &x);
+
+    for (int k = 0; k < 3; k++) {
+        min->val[k] = fmin(min->val[k], x.val[k]);
+        max->val[k] = fmax(max->val[k], x.val[k]);
+    }
+}
+
+/*
+    Transform the 8 corners of the box [bmin, bmax] by m and grow [min, max]
+    to include them.
+ */
+static void boundsAddBox(Point *min, Point *max, Matrix *m, Point *bmin,
+                         Point *bmax) {
+    Point corner;
+    corner.val[3] = 1.0;
+
+    for (int c = 0; c < 8; c++) {
+        corner.val[0] = (c & 1) ? bmax->val[0] : bmin->val[0];
+        corner.val[1] = (c & 2) ? bmax->val[1] : bmin->val[1];
+        corner.val[2] = (c & 4) ? bmax->val[2] : bmin->val[2];
+        boundsAdd(min, max, m, &corner);
+    }
+}
+
+/*
+    Return the newest change stamp of the module and everything it includes.
+ */
+static unsigned long moduleNewest(Module *md) {
+    unsigned long newest = md->changed;
+
+    for (Element *i = md->head; i; i = i->next) {
+        if (i->type == ObjModule) {
+            unsigned long sub = moduleNewest(i->obj.module);
+            newest = sub > newest ? sub : newest;
+        }
     }
+
+    return newest;
 }
 
 /**
- * Draw the module into the image using the given VTM, Lighting, and DrawState
- * by traversing the list of Elements.
+ * Compute the axis-aligned bounding box of everything the module draws, in
+ * the module's own coordinates, and store its corners in min and max.
+ * Matrices and submodules are applied the same way module_draw() applies
+ * them, and Bezier curves are bounded by their control points. The box is
+ * cached in the module until it or a module it includes is changed; other
+ * modules can change freely. Returns 0 if the module contains no geometry,
+ * 1 otherwise.
  */
-void module_draw(Module *md, Matrix *VTM, Matrix *GTM,\
-                 DrawState *ds, Lighting *lighting, Image *src) {
+int module_bounds(Module *md, Point *min, Point *max) {
+    unsigned long newest;
+
+    if (!md || !min || !max) {
+        printf("module_bounds(): passed NULL pointer.\n");
+        return 0;
+    }
+
+    newest = moduleNewest(md);
+    if (md->boundsStamp != newest) {
+        Point *bmin = &md->boundsMin;
+        Point *bmax = &md->boundsMax;
+        Point subMin, subMax;
+        Matrix LTM;
+        matrix_identity(&LTM);
+        point_set3D(bmin, HUGE_VAL, HUGE_VAL, HUGE_VAL);
+        point_set3D(bmax, -HUGE_VAL, -HUGE_VAL, -HUGE_VAL);
+
+        for (Element *i = md->head; i; i = i->next) {
+            switch (i->type) {
+            case ObjPoint:
+                boundsAdd(bmin, bmax, &LTM, &(i->obj.point));
+                break;
+
+            case ObjLine:
+                boundsAdd(bmin, bmax, &LTM, &(i->obj.line.a));
+                boundsAdd(bmin, bmax, &LTM, &(i->obj.line.b));
+                break;
+
+            case ObjPolyline:
+                for (int k = 0; k < i->obj.polyline.numVertex; k++) {
+                    boundsAdd(bmin, bmax, &LTM, &(i->obj.polyline.vertex[k]));
+                }
+                break;
+
+            case ObjPolygon:
+                for (int k = 0; k < i->obj.polygon.nVertex; k++) {
+                    boundsAdd(bmin, bmax, &LTM, &(i->obj.polygon.vertex[k]));
+                }
+                break;
+
+            case ObjBezier:
+                for (int k = 0; k < 4; k++) {
+                    boundsAdd(bmin, bmax, &LTM, &(i->obj.curve.ctrls[k]));
+                }
+                break;
+
+            case ObjMesh:
+                for (int k = 0; k < i->obj.mesh->nVertex; k++) {
+                    boundsAdd(bmin, bmax, &LTM, &(i->obj.mesh->vertex[k]));
+                }
+                break;
+
+            case ObjMatrix:
+                matrix_multiply(&(i->obj.matrix), &LTM, &LTM);
+                break;
+
+            case ObjIdentity:
+                matrix_identity(&LTM);
+                break;
+
+            case ObjModule:
+                if (module_bounds(i->obj.module, &subMin, &subMax)) {
+                    boundsAddBox(bmin, bmax, &LTM, &subMin, &subMax);
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        md->boundsStamp = newest;
+    }
+
+    point_copy(min, &md->boundsMin);
+    point_copy(max, &md->boundsMax);
+    return min->val[0] <= max->val[0];
+}
+
+/*
+    Return 1 if the module's bounding box, transformed by GTM and then VTM,
+    lies entirely outside one plane of the view volume cv, in which case
+    nothing in the module can be drawn.
+ */
+static int moduleCulled(Module *md, Matrix *VTM, Matrix *GTM, ClipVolume *cv) {
+    Point min, max, corner, screen;
+    Matrix TM;
+    int andCode = CLIP_ALL;
+
+    if (!module_bounds(md, &min, &max)) {
+        return 0;
+    }
+
+    matrix_multiply(VTM, GTM, &TM);
+    corner.val[3] = 1.0;
+    for (int c = 0; c < 8 && andCode; c++) {
+        corner.val[0] = (c & 1) ? max.val[0] : min.val[0];
+        corner.val[1] = (c & 2) ? max.val[1] : min.val[1];
+        corner.val[2] = (c & 4) ? max.val[2] : min.val[2];
+        matrix_xformPoint(&TM, &corner, &screen);
+        andCode &= point_outcode(&screen, cv);
+    }
+
+    return andCode != 0;
+}
+
+/**
+ * Reset the counts reported by module_stats() to zero.
+ */
+void module_resetStats(void) {
+    atomic_store(&statPolygons, 0);
+    atomic_store(&statBackFaces, 0);
+    atomic_store(&statClipped, 0);
+    atomic_store(&statModules, 0);
+}
+
+/**
+ * Copy the counts of polygons drawn and skipped by module_draw() since the
+ * last module_resetStats() into stats.
+ */
+void module_stats(ModuleStats *stats) {
+    if (!stats) {
+        printf("module_stats(): passed NULL pointer.\n");
+        return;
+    }
+
+    stats->polygons = atomic_load(&statPolygons);
+    stats->backFaces = atomic_load(&statBackFaces);
+    stats->clipped = atomic_load(&statClipped);
+    stats->modules = atomic_load(&statModules);
+}
+
+/*
+    Draw the module into the image using the given VTM, Lighting, and
+    DrawState by traversing the list of Elements. The Lighting already holds
+    the lights placed in the scene.
+ */
+static void drawModule(Module *md, Matrix *VTM, Matrix *GTM,
+                       DrawState *ds, Lighting *lighting, Image *src) {
+    ClipVolume clip;
+    clipvolume_set(&clip, src, ds);
+
+    // Skip the whole module when its bounding box is outside the view
+    if (moduleCulled(md, VTM, GTM, &clip)) {
+        atomic_fetch_add_explicit(&statModules, 1, memory_order_relaxed);
+        return;
+    }
+
+    /* Polygons are clipped to the image and the DrawState's near/far range.
+    Outlines are only clipped in depth so the image border isn't drawn as an
+    edge of every polygon crossing it */
+    if (ds->shade == ShadeFrame) {
+        clip.planes = CLIP_NEAR | CLIP_FAR;
+    }
+
     // Set the matrix LTM to identity
     Matrix *LTM = malloc(sizeof(Matrix));
     matrix_identity(LTM);
+    Matrix world; // GTM * LTM, rebuilt when the LTM changes
+    Matrix normalTM; // inverse transpose of world, for the normals
+    Matrix TM; // VTM * GTM * LTM, likewise
+    int tmStale = 1;
+
+    // Flat and Gouraud shading light the vertices in world coordinates
+    int lit = ds->shade == ShadeFlat || ds->shade == ShadeGouraud;
+    // Phong shading keeps the world coordinate normals for the G-buffer
+    int worldNormals = lit || ds->shade == ShadePhong;
 
     // For each element E in module md:
     Element *i = md->head;
@@ -467,9 +658,28 @@ void module_draw(Module *md, Matrix *VTM, Matrix *GTM,\
         case ObjColor:
             color_copy(&(ds->color), &(i->obj.color));
             break;
+
+        case ObjBodyColor:
+            color_copy(&(ds->body), &(i->obj.color));
+            break;
+
+        case ObjSurfaceColor:
+            color_copy(&(ds->surface), &(i->obj.color));
+            break;
+
+        case ObjSurfaceCoeff:
+            ds->surfaceCoeff = i->obj.coeff;
+            break;
+
+        case ObjLight:
+            // Already in the Lighting, gathered by module_draw()
+            break;
         
         case ObjPoint: ;
             //printf("drawing point\n");
+            if (ds->shade == ShadeDepthOnly) {
+                break; // Only surfaces go into the z-buffer
+            }
             Point *x = malloc(sizeof(Point));
             // Copy the point data in E to X
             point_copy(x, &(i->obj.point));
@@ -492,6 +702,9 @@ void module_draw(Module *md, Matrix *VTM, Matrix *GTM,\
             break;
 
         case ObjLine: ;
+            if (ds->shade == ShadeDepthOnly) {
+                break;
+            }
             Line *l = malloc(sizeof(Line));
             
             // Copy the line data in E to L
@@ -513,6 +726,9 @@ void module_draw(Module *md, Matrix *VTM, Matrix *GTM,\
             break;
 
         case ObjPolyline: ;
+            if (ds->shade == ShadeDepthOnly) {
+                break;
+            }
             printf("drawing polyline\n");
             // Copy polyline data to PL:
             Polyline *pl = polyline_create();
@@ -541,21 +757,55 @@ void module_draw(Module *md, Matrix *VTM, Matrix *GTM,\
             Polygon* p = polygon_create();
             polygon_copy(p, &(i->obj.polygon));
 
-            // Transform P by the LTM
-            matrix_xformPolygon(LTM, p);
+            // Transform P by VTM * GTM * LTM, composed once per LTM
+            if (tmStale) {
+                matrix_multiply(GTM, LTM, &world);
+                matrix_multiply(VTM, &world, &TM);
+                matrix_inverseTranspose(&world, &normalTM);
+                tmStale = 0;
+            }
+            if (worldNormals) {
+                /* Shade P in world coordinates, then take only the
+                vertices to the screen. Clipping interpolates the vertex
+                colors and normals */
+                matrix_xformPolygonNormal(&world, &normalTM, p);
+                if (lit) {
+                    lighting_shadePolygon(lighting, p, ds);
+                }
+                for (int k = 0; k < p->nVertex; k++) {
+                    matrix_xformPoint(VTM, &p->vertex[k], &p->vertex[k]);
+                }
+            } else {
+                matrix_xformPolygon(&TM, p);
+            }
 
-            // Transform P by the GTM
-            matrix_xformPolygon(GTM, p);
+            atomic_fetch_add_explicit(&statPolygons, 1, memory_order_relaxed);
 
-            // Transform P by the VTM
-            matrix_xformPolygon(VTM, p);
+            // Clip P to the view volume, skipping it if nothing is left
+            if (!polygon_clip(p, &clip)) {
+                atomic_fetch_add_explicit(&statClipped, 1,
+                                          memory_order_relaxed);
+                polygon_free(p);
+                break;
+            }
 
             // Normalize P by the homogenous coord
             polygon_normalize(p);
 
+            // Skip filling one-sided polygons that face away from the viewer
+            if (p->oneSided && ds->shade != ShadeFrame &&
+                polygon_backFacing(p)) {
+                atomic_fetch_add_explicit(&statBackFaces, 1,
+                                          memory_order_relaxed);
+                polygon_free(p);
+                break;
+            }
+
             // If DS->shade is ShadeFrame -> Draw boundary lines
             if (ds->shade == ShadeFrame) {
                 polygon_draw(p, src, ds->color);
+            } else if (lit) {
+                polygon_drawFill(p, src, ds->flatColor, ds);
             } else {
                 // If DS->shade is ShadeConstant -> draw filled using DS->color
                 polygon_drawFill(p, src, ds->color, ds);
@@ -569,12 +819,14 @@ void module_draw(Module *md, Matrix *VTM, Matrix *GTM,\
             //printf("drawing matrix\n");
             // Left multiply LTM by Matrix field of E (LTM = E * LTM)
             matrix_multiply(&(i->obj.matrix), LTM, LTM);
+            tmStale = 1;
             break;
         
         case ObjIdentity:
             // printf("drawing identity\n");
             // Set LTM to the identity matrix
             matrix_identity(LTM);
+            tmStale = 1;
             break;
         
         case ObjModule: ;
@@ -590,28 +842,40 @@ void module_draw(Module *md, Matrix *VTM, Matrix *GTM,\
             drawstate_copy(tempDS, ds);
 
             // recursively call module_draw
-            module_draw(i->obj.module, VTM, tempGTM, tempDS, lighting, src);
+            drawModule(i->obj.module, VTM, tempGTM, tempDS, lighting, src);
             // printf("Done drawing module\n");
             free(tempGTM);
             free(tempDS);
             break;
 
         case ObjBezier: ;
+            if (ds->shade == ShadeDepthOnly) {
+                break;
+            }
             //printf("drawing curve\n");
-            // Copy the polygon data in E to P
-            BezierCurve* b = malloc(sizeof(BezierCurve));
-            bezierCurve_init(b);
-            bezierCurve_copy(b, &(i->obj.curve));
+            // Copy the curve data in E to B - the curve lives on the stack
+            BezierCurve b;
+            bezierCurve_copy(&b, &(i->obj.curve));
 
             for (int point = 0; point < 4; point++) {
-                matrix_xformPoint(LTM, &b->ctrls[point], &b->ctrls[point]);
-                matrix_xformPoint(GTM, &b->ctrls[point], &b->ctrls[point]);
-                matrix_xformPoint(VTM, &b->ctrls[point], &b->ctrls[point]);
-                point_normalize(&b->ctrls[point]);
+                matrix_xformPoint(LTM, &b.ctrls[point], &b.ctrls[point]);
+                matrix_xformPoint(GTM, &b.ctrls[point], &b.ctrls[point]);
+                matrix_xformPoint(VTM, &b.ctrls[point], &b.ctrls[point]);
+                point_normalize(&b.ctrls[point]);
             }
 
-            bezierCurve_draw_with_subdivisions(b, b->subdivisions, 0, src, ds->color);
-            free(b);
+            bezierCurve_draw_with_subdivisions(&b, b.subdivisions, 0, src, ds->color);
+            break;
+
+        case ObjMesh: ;
+            // Each shared vertex is transformed (and lit) only once
+            Matrix meshWorld;
+            int backFaces;
+            matrix_multiply(GTM, LTM, &meshWorld);
+            backFaces = mesh_draw(i->obj.mesh, VTM, &meshWorld, ds,
+                                  lighting, src);
+            atomic_fetch_add_explicit(&statBackFaces, backFaces,
+                                      memory_order_relaxed);
             break;
 
         default:
@@ -624,6 +888,319 @@ void module_draw(Module *md, Matrix *VTM, Matrix *GTM,\
     free(LTM);
 }
 
+/**
+ * Add every light placed in the module to lighting, transformed to world
+ * coordinates by GTM and the matrices in effect where it was added.
+ */
+void module_lighting(Module *md, Matrix *GTM, Lighting *lighting) {
+    Matrix LTM, world;
+    Light light;
+
+    if (!md || !GTM || !lighting) {
+        printf("module_lighting(): passed NULL pointer.\n");
+        return;
+    }
+
+    matrix_identity(&LTM);
+    for (Element *i = md->head; i; i = i->next) {
+        switch (i->type) {
+        case ObjLight:
+            light = i->obj.light;
+            matrix_multiply(GTM, &LTM, &world);
+            light_xform(&world, &light);
+            lighting_add(lighting, &light);
+            break;
+
+        case ObjMatrix:
+            matrix_multiply(&(i->obj.matrix), &LTM, &LTM);
+            break;
+
+        case ObjIdentity:
+            matrix_identity(&LTM);
+            break;
+
+        case ObjModule:
+            matrix_multiply(GTM, &LTM, &world);
+            module_lighting(i->obj.module, &world, lighting);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ * Draw the module into the image using the given VTM, Lighting, and DrawState
+ * by traversing the list of Elements. For ShadeFlat, ShadeGouraud and
+ * ShadePhong the polygons are lit by the lights in lighting (which may be
+ * NULL) together with the lights placed in the module; lighting itself is not
+ * changed. ShadePhong is deferred: the module is drawn into the image's
+ * G-buffer, which is allocated if needed, and only the pixels left visible
+ * are lit, once each, by lighting_shadeGBuffer().
+ */
+void module_draw(Module *md, Matrix *VTM, Matrix *GTM,
+                 DrawState *ds, Lighting *lighting, Image *src) {
+    Lighting scene;
+
+    if (!md || !VTM || !GTM || !ds || !src) {
+        printf("module_draw(): passed NULL pointer.\n");
+        return;
+    }
+
+    /* Every light has to be known before the first polygon is shaded, so
+    the module's lights are gathered ahead of drawing it */
+    if (ds->shade == ShadeFlat || ds->shade == ShadeGouraud ||
+        ds->shade == ShadePhong) {
+        if (lighting) {
+            scene = *lighting;
+        } else {
+            lighting_init(&scene);
+        }
+        module_lighting(md, GTM, &scene);
+        lighting = &scene;
+    }
+
+    if (ds->shade == ShadePhong) {
+        // Pixels drawn before this call keep the colors they already have
+        if (image_allocGBuffer(src)) {
+            return;
+        }
+        image_clearGBuffer(src);
+    }
+
+    drawModule(md, VTM, GTM, ds, lighting, src);
+
+    if (ds->shade == ShadePhong) {
+        lighting_shadeGBuffer(lighting, src, VTM, &(ds->viewer));
+    }
+}
+
+
+/*
+    Append the contents of md to flat with every primitive transformed to
+    world coordinates by GTM and the module's own matrices, so flat holds no
+    matrices or submodules. ds is the DrawState in effect inside md, and
+    written is the DrawState that the elements already in flat leave behind;
+    color and reflectance elements are appended whenever a primitive needs
+    different ones. Meshes keep their shared vertices, so they are wrapped in
+    their world matrix instead.
+ */
+static void module_flatten(Module *md, Matrix *GTM, DrawState *ds,
+                           Module *flat, DrawState *written) {
+    Matrix LTM, world, normalTM;
+    Element *e;
+    matrix_identity(&LTM);
+    matrix_copy(&world, GTM);
+    matrix_inverseTranspose(&world, &normalTM);
+
+    for (Element *i = md->head; i; i = i->next) {
+        switch (i->type) {
+        case ObjPoint:
+        case ObjLine:
+        case ObjPolyline:
+        case ObjPolygon:
+        case ObjBezier:
+        case ObjMesh:
+            if (memcmp(&ds->color, &written->color, sizeof(Color))) {
+                module_color(flat, &ds->color);
+                color_copy(&written->color, &ds->color);
+            }
+            if (memcmp(&ds->body, &written->body, sizeof(Color))) {
+                module_bodyColor(flat, &ds->body);
+                color_copy(&written->body, &ds->body);
+            }
+            if (memcmp(&ds->surface, &written->surface, sizeof(Color))) {
+                module_surfaceColor(flat, &ds->surface);
+                color_copy(&written->surface, &ds->surface);
+            }
+            if (ds->surfaceCoeff != written->surfaceCoeff) {
+                module_surfaceCoeff(flat, ds->surfaceCoeff);
+                written->surfaceCoeff = ds->surfaceCoeff;
+            }
+            break;
+        default:
+            break;
+        }
+
+        switch (i->type) {
+        case ObjColor:
+            color_copy(&ds->color, &(i->obj.color));
+            break;
+
+        case ObjBodyColor:
+            color_copy(&ds->body, &(i->obj.color));
+            break;
+
+        case ObjSurfaceColor:
+            color_copy(&ds->surface, &(i->obj.color));
+            break;
+
+        case ObjSurfaceCoeff:
+            ds->surfaceCoeff = i->obj.coeff;
+            break;
+
+        case ObjLight:
+            e = element_init(ObjLight, &(i->obj.light));
+            light_xform(&world, &(e->obj.light));
+            module_insert(flat, e);
+            break;
+
+        case ObjPoint:
+            e = element_init(ObjPoint, &(i->obj.point));
+            matrix_xformPoint(&world, &(e->obj.point), &(e->obj.point));
+            module_insert(flat, e);
+            break;
+
+        case ObjLine:
+            e = element_init(ObjLine, &(i->obj.line));
+            matrix_xformLine(&world, &(e->obj.line));
+            module_insert(flat, e);
+            break;
+
+        case ObjPolyline:
+            e = element_init(ObjPolyline, &(i->obj.polyline));
+            matrix_xformPolyline(&world, &(e->obj.polyline));
+            module_insert(flat, e);
+            break;
+
+        case ObjPolygon:
+            e = element_init(ObjPolygon, &(i->obj.polygon));
+            matrix_xformPolygonNormal(&world, &normalTM,
+                                      &(e->obj.polygon));
+            module_insert(flat, e);
+            break;
+
+        case ObjBezier:
+            e = element_init(ObjBezier, &(i->obj.curve));
+            for (int k = 0; k < 4; k++) {
+                matrix_xformPoint(&world, &(e->obj.curve.ctrls[k]),
+                                  &(e->obj.curve.ctrls[k]));
+            }
+            module_insert(flat, e);
+            break;
+
+        case ObjMesh:
+            module_insert(flat, element_init(ObjMatrix, &world));
+            module_insert(flat, element_init(ObjMesh,
+                                             mesh_retain(i->obj.mesh)));
+            module_identity(flat);
+            break;
+
+        case ObjMatrix:
+            matrix_multiply(&(i->obj.matrix), &LTM, &LTM);
+            matrix_multiply(GTM, &LTM, &world);
+            matrix_inverseTranspose(&world, &normalTM);
+            break;
+
+        case ObjIdentity:
+            matrix_identity(&LTM);
+            matrix_copy(&world, GTM);
+            matrix_inverseTranspose(&world, &normalTM);
+            break;
+
+        case ObjModule: ;
+            DrawState subDS;
+            drawstate_copy(&subDS, ds);
+            module_flatten(i->obj.module, &world, &subDS, flat, written);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+/* Shared arguments of the per-view tasks of module_drawMultiView() */
+typedef struct {
+    Module *flat; // the scene in world coordinates
+    Point min, max; // bounding box of flat
+    int empty; // flat holds no geometry
+    DrawState *ds;
+    Lighting *lighting;
+    ViewPipeline *views;
+    Image **images;
+} MultiViewJob;
+
+/*
+    Draw the flattened scene through one view into its image.
+ */
+static void multiView_task(int index, int worker, void *arg) {
+    MultiViewJob *job = arg;
+    ViewPipeline *vp = &job->views[index];
+    DrawState ds;
+    Matrix identity;
+
+    if (job->empty || !viewpipeline_visible(vp, &job->min, &job->max)) {
+        return;
+    }
+
+    drawstate_copy(&ds, job->ds);
+    drawstate_setClip(&ds, vp->clipNear, vp->clipFar);
+    matrix_identity(&identity);
+    module_draw(job->flat, &vp->vtm, &identity, &ds, job->lighting,
+                job->images[index]);
+}
+
+/**
+ * Draw the module through each of nViews view pipelines, into the image of
+ * the same index. The module is traversed and transformed to world
+ * coordinates only once, with GTM as its global transform and ds as the
+ * starting DrawState; the views are then drawn in parallel, each clipped to
+ * its own front and back planes. The images must be distinct.
+ */
+void module_drawMultiView(Module *md, Matrix *GTM, DrawState *ds,
+                          Lighting *lighting, ViewPipeline *views,
+                          Image **images, int nViews) {
+    if (!md || !GTM || !ds || !views || !images) {
+        printf("module_drawMultiView(): passed NULL pointer.\n");
+        return;
+    }
+    if (nViews <= 0) {
+        return;
+    }
+
+    MultiViewJob job;
+    DrawState state, written;
+    job.flat = module_create();
+    drawstate_copy(&state, ds);
+    drawstate_copy(&written, ds);
+    module_flatten(md, GTM, &state, job.flat, &written);
+
+    // Fill the bounding box cache now, before the views read it concurrently
+    job.empty = !module_bounds(job.flat, &job.min, &job.max);
+    job.ds = ds;
+    job.lighting = lighting;
+    job.views = views;
+    job.images = images;
+
+    parallel_for(nViews, multiView_task, &job);
+
+    module_delete(job.flat);
+}
+
+/**
+ * Draw the module into the shadow map's depth image through its view, with
+ * GTM as the global transform. Only polygons and solid meshes are drawn, with
+ * ShadeDepthOnly, so no colors are computed; the map is cleared first.
+ */
+void module_drawShadowMap(Module *md, Matrix *GTM, ShadowMap *sm) {
+    if (!md || !GTM || !sm) {
+        printf("module_drawShadowMap(): passed NULL pointer.\n");
+        return;
+    }
+
+    DrawState *ds = drawstate_create();
+    if (!ds) {
+        return;
+    }
+    ds->shade = ShadeDepthOnly;
+    drawstate_setClip(ds, sm->clipNear, sm->clipFar);
+
+    imagefillz(sm->depth, 0.0);
+    module_draw(md, &sm->vtm, GTM, ds, NULL, sm->depth);
+    free(ds);
+}
 
 /* 3D MODULE FUNCTIONS */
 
@@ -643,13 +1220,7 @@ void module_translate(Module *md, double tx, double ty, double tz) {
     Element *e = element_init(ObjMatrix, m);
     free(m);
 
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -668,13 +1239,7 @@ void module_scale(Module *md, double sx, double sy, double sz) {
     Element *e = element_init(ObjMatrix, m);
     free(m);
 
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -693,13 +1258,7 @@ void module_rotateX(Module *md, double cth, double sth) {
     Element *e = element_init(ObjMatrix, m);
     free(m);
 
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -718,13 +1277,7 @@ void module_rotateY(Module *md, double cth, double sth) {
     Element *e = element_init(ObjMatrix, m);
     free(m);
 
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 
@@ -744,13 +1297,7 @@ void module_rotateXYZ(Module *md, Vector *u, Vector *v, Vector *w) {
     Element *e = element_init(ObjMatrix, m);
     free(m);
 
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -801,70 +1348,29 @@ void module_cube(Module *md, int solid) {
             module_line(md, &(edge[i]));
         }
     } else {
-        polygon_init(&side);
-
-        // Top side:
-        polygon_set(&(side), 4, &(p[0]));
-        Vector normal = {{0.0, 1.0, 0.0}};
-        for (i = 0; i < 4; i++) vector_copy(&side.normal[i], &normal);
-        module_polygon(md, &side);
-        polygon_clear(&side);
-
-        // Bottom side:
-        polygon_set(&(side), 4, &(p[4]));
-        vector_set(&normal, 0.0, -1.0, 0.0);
-        for (i = 0; i < 4; i++) vector_copy(&side.normal[i], &normal);
-        module_polygon(md, &side);
-        polygon_clear(&side);
-
-        // front side (positive z):
-        point_copy(&(tv[0]), &(p[0]));
-        point_copy(&(tv[1]), &(p[3]));
-        point_copy(&(tv[2]), &(p[7]));
-        point_copy(&(tv[3]), &(p[4]));
-        polygon_set(&(side), 4, &(tv[0]));
-        vector_set(&normal, 0.0, 0.0, 1.0);
-        for (i = 0; i < 4; i++) vector_copy(&side.normal[i], &normal);
-        module_polygon(md, &side);
-        polygon_clear(&side);
-
-        // back side (negative z):
-        point_copy(&(tv[0]), &(p[1]));
-        point_copy(&(tv[1]), &(p[2]));
-        point_copy(&(tv[2]), &(p[6]));
-        point_copy(&(tv[3]), &(p[5]));
-        polygon_set(&(side), 4, &(tv[0]));
-        vector_set(&normal, 0.0, 0.0, -1.0);
-        for (i = 0; i < 4; i++) vector_copy(&side.normal[i], &normal);
-        module_polygon(md, &side);
-        polygon_clear(&side);
+        /* Each side as indices into p[], wound counter-clockwise as seen from
+        outside the cube so the sides can be drawn one-sided */
+        int face[6][4] = {{0, 1, 2, 3}, // top (positive y)
+                          {4, 7, 6, 5}, // bottom (negative y)
+                          {0, 3, 7, 4}, // front (positive z)
+                          {1, 5, 6, 2}, // back (negative z)
+                          {3, 2, 6, 7}, // left (negative x)
+                          {0, 4, 5, 1}}; // right (positive x)
+        Vector normal[6] = {{{0.0, 1.0, 0.0}}, {{0.0, -1.0, 0.0}},
+                            {{0.0, 0.0, 1.0}}, {{0.0, 0.0, -1.0}},
+                            {{-1.0, 0.0, 0.0}}, {{1.0, 0.0, 0.0}}};
 
-        // left side (negative x)
-        point_copy(&(tv[0]), &(p[3]));
-        point_copy(&(tv[1]), &(p[2]));
-        point_copy(&(tv[2]), &(p[6]));
-        point_copy(&(tv[3]), &(p[7]));
-        polygon_set(&(side), 4, &(tv[0]));
-        vector_set(&normal, -1.0, 0.0, 0.0);
-        for (i = 0; i < 4; i++) vector_copy(&side.normal[i], &normal);
-        module_polygon(md, &side);
-        polygon_clear(&side);
-
-        // right side (positive x):
-        point_copy(&(tv[0]), &(p[0]));
-        point_copy(&(tv[1]), &(p[1]));
-        point_copy(&(tv[2]), &(p[5]));
-        point_copy(&(tv[3]), &(p[4]));
-        polygon_set(&(side), 4, &(tv[0]));
-        vector_set(&normal, 1.0, 0.0, 0.0);
-        for (i = 0; i < 4; i++) vector_copy(&side.normal[i], &normal);
-        module_polygon(md, &side);
+        polygon_init(&side);
+        polygon_setSided(&side, 1);
+        for (int f = 0; f < 6; f++) {
+            for (i = 0; i < 4; i++) {
+                point_copy(&(tv[i]), &(p[face[f][i]]));
+            }
+            polygon_set(&(side), 4, &(tv[0]));
+            for (i = 0; i < 4; i++) vector_copy(&side.normal[i], &normal[f]);
+            module_polygon(md, &side);
+        }
         polygon_clear(&side);
-        
-        // for (i = 0; i < 2; i++) {
-        //     module_polygon(md, &(side[i])); // Add the polygon to the module
-        //     polygon_clear(&(side[i])); // free the polygon
-        // }
     }
 }
 
@@ -877,135 +1383,58 @@ void module_bezierCurve(Module *m, BezierCurve *b, int divisions) {
 
     b->subdivisions = divisions;
     Element *e = element_init(ObjBezier, b);
-    if (!m->tail) {
-        m->head = e;
-        m->tail = e;
-    } else {
-        m->tail->next = e; // Set the last element in the list to point to e
-        m->tail = e; // Set the last element to be e.
-    }
+    module_insert(m, e);
 }
 
+/**
+ * Tessellate the Bezier surface into a single Mesh and add it to the module.
+ * Identical patches share one Mesh through the tessellation cache. The patch
+ * is sampled on a (3 << divisions) grid in each direction; solid surfaces
+ * become triangles, otherwise each grid line segment is drawn once.
+ */
 void module_bezierSurface(Module *m, BezierSurface *b, int divisions, int solid) {
-    b->subdivisions = divisions;
-    Line l;
-    if (divisions <= 0) {
-        switch(solid) {
-            case 0:
-                for (int i = 0; i < 4; i++) {
-                    for (int j = 1; j < 4; j++) {
-                        line_set(&l, b->ctrls[i*4 + j - 1], b->ctrls[i*4 + j]);
-                        module_line(m, &l);
-                        line_set(&l, b->ctrls[(j-1)*4 + i], b->ctrls[j*4 + i]);                        
-                        module_line(m, &l);
-                    }
-                }
-                return;
-
-            default:
-                return;
-        }
+    if (!m || !b) {
+        printf("module_bezierSurface(): passed null pointer.\n");
+        return;
     }
-    
-    BezierSurface q, r;
-    bezierSurface_init(&q);
-    bezierSurface_copy(&q, b); //TODO: cleanup this copy
-    bezierSurface_init(&r);
-    bezierSurface_copy(&r, b);
-
-    // Subdivide in x:
-    for (int i = 0; i < 4; i++) {
-        q.ctrls[i*4 + 1].val[0] = (b->ctrls[i*4].val[0] + b->ctrls[i*4 + 1].val[0]) / 2;
-        q.ctrls[i*4 + 1].val[1] = (b->ctrls[i*4].val[1] + b->ctrls[i*4 + 1].val[1]) / 2;
-        q.ctrls[i*4 + 1].val[2] = (b->ctrls[i*4].val[2] + b->ctrls[i*4 + 1].val[2]) / 2;
-
-        q.ctrls[i*4 + 2].val[0] = (q.ctrls[i*4 + 1].val[0] / 2) + (b->ctrls[i*4 + 1].val[0] + b->ctrls[i*4 + 2].val[0]) / 4;
-        q.ctrls[i*4 + 2].val[1] = (q.ctrls[i*4 + 1].val[1] / 2) + (b->ctrls[i*4 + 1].val[1] + b->ctrls[i*4 + 2].val[1]) / 4;
-        q.ctrls[i*4 + 2].val[2] = (q.ctrls[i*4 + 1].val[2] / 2) + (b->ctrls[i*4 + 1].val[2] + b->ctrls[i*4 + 2].val[2]) / 4;
-
-        r.ctrls[i*4 + 2].val[0] = (b->ctrls[i*4 + 2].val[0] + b->ctrls[i*4 + 3].val[0]) / 2;
-        r.ctrls[i*4 + 2].val[1] = (b->ctrls[i*4 + 2].val[1] + b->ctrls[i*4 + 3].val[1]) / 2;
-        r.ctrls[i*4 + 2].val[2] = (b->ctrls[i*4 + 2].val[2] + b->ctrls[i*4 + 3].val[2]) / 2;
-
-        r.ctrls[i*4 + 1].val[0] = (r.ctrls[i*4 + 2].val[0] / 2) + (b->ctrls[i*4 + 1].val[0] + b->ctrls[i*4 + 2].val[0]) / 4;
-        r.ctrls[i*4 + 1].val[1] = (r.ctrls[i*4 + 2].val[1] / 2) + (b->ctrls[i*4 + 1].val[1] + b->ctrls[i*4 + 2].val[1]) / 4;
-        r.ctrls[i*4 + 1].val[2] = (r.ctrls[i*4 + 2].val[2] / 2) + (b->ctrls[i*4 + 1].val[2] + b->ctrls[i*4 + 2].val[2]) / 4;
 
-        q.ctrls[i*4 + 3].val[0] = (q.ctrls[i*4 + 2].val[0] + r.ctrls[i*4 + 1].val[0]) / 2;
-        q.ctrls[i*4 + 3].val[1] = (q.ctrls[i*4 + 2].val[1] + r.ctrls[i*4 + 1].val[1]) / 2;
-        q.ctrls[i*4 + 3].val[2] = (q.ctrls[i*4 + 2].val[2] + r.ctrls[i*4 + 1].val[2]) / 2;
-
-        point_copy(&r.ctrls[i*4 + 0], &q.ctrls[i*4 + 3]);
+    b->subdivisions = divisions;
+    Mesh *mesh = bezierSurface_tessellateCached(b, divisions, solid);
+    if (!mesh) {
+        return;
     }
+    module_mesh(m, mesh);
+}
 
-    BezierSurface qUp, qDown, rUp, rDown;
-    bezierSurface_init(&qUp);
-    bezierSurface_copy(&qUp, &q); //TODO: cleanup this copy
-    bezierSurface_init(&rUp);
-    bezierSurface_copy(&rUp, &r);
-    bezierSurface_init(&qDown);
-    bezierSurface_copy(&qDown, &q); //TODO: cleanup this copy
-    bezierSurface_init(&rDown);
-    bezierSurface_copy(&rDown, &r);
-
-    // Subdivide q in z:
-    for (int i = 0; i < 4; i++) {
-        qUp.ctrls[i + 1 * 4].val[0] = (q.ctrls[i].val[0] + q.ctrls[i + 1 * 4].val[0]) / 2;
-        qUp.ctrls[i + 1 * 4].val[1] = (q.ctrls[i].val[1] + q.ctrls[i + 1 * 4].val[1]) / 2;
-        qUp.ctrls[i + 1 * 4].val[2] = (q.ctrls[i].val[2] + q.ctrls[i + 1 * 4].val[2]) / 2;
-
-        qUp.ctrls[i + 2 * 4].val[0] = (qUp.ctrls[i + 1 * 4].val[0] / 2) + (q.ctrls[i + 1 * 4].val[0] + q.ctrls[i + 2 * 4].val[0]) / 4;
-        qUp.ctrls[i + 2 * 4].val[1] = (qUp.ctrls[i + 1 * 4].val[1] / 2) + (q.ctrls[i + 1 * 4].val[1] + q.ctrls[i + 2 * 4].val[1]) / 4;
-        qUp.ctrls[i + 2 * 4].val[2] = (qUp.ctrls[i + 1 * 4].val[2] / 2) + (q.ctrls[i + 1 * 4].val[2] + q.ctrls[i + 2 * 4].val[2]) / 4;
-
-        qDown.ctrls[i + 2 * 4].val[0] = (q.ctrls[i + 2 * 4].val[0] + q.ctrls[i + 3 * 4].val[0]) / 2;
-        qDown.ctrls[i + 2 * 4].val[1] = (q.ctrls[i + 2 * 4].val[1] + q.ctrls[i + 3 * 4].val[1]) / 2;
-        qDown.ctrls[i + 2 * 4].val[2] = (q.ctrls[i + 2 * 4].val[2] + q.ctrls[i + 3 * 4].val[2]) / 2;
-
-        qDown.ctrls[i + 1 * 4].val[0] = (qDown.ctrls[i + 2 * 4].val[0] / 2) + (q.ctrls[i + 1 * 4].val[0] + q.ctrls[i + 2 * 4].val[0]) / 4;
-        qDown.ctrls[i + 1 * 4].val[1] = (qDown.ctrls[i + 2 * 4].val[1] / 2) + (q.ctrls[i + 1 * 4].val[1] + q.ctrls[i + 2 * 4].val[1]) / 4;
-        qDown.ctrls[i + 1 * 4].val[2] = (qDown.ctrls[i + 2 * 4].val[2] / 2) + (q.ctrls[i + 1 * 4].val[2] + q.ctrls[i + 2 * 4].val[2]) / 4;
-
-        qUp.ctrls[i + 3 * 4].val[0] = (qUp.ctrls[i + 2 * 4].val[0] + qDown.ctrls[i + 1 * 4].val[0]) / 2;
-        qUp.ctrls[i + 3 * 4].val[1] = (qUp.ctrls[i + 2 * 4].val[1] + qDown.ctrls[i + 1 * 4].val[1]) / 2;
-        qUp.ctrls[i + 3 * 4].val[2] = (qUp.ctrls[i + 2 * 4].val[2] + qDown.ctrls[i + 1 * 4].val[2]) / 2;
-
-        point_copy(&qDown.ctrls[i], &qUp.ctrls[i + 3 * 4]);
+/**
+ * Add the Mesh to the tail of the module's list. The module takes over the
+ * caller's reference to the Mesh and releases it when the module is cleared.
+ */
+void module_mesh(Module *md, Mesh *mesh) {
+    if (!md || !mesh) {
+        printf("module_mesh(): passed null pointer.\n");
+        return;
     }
+    Element *e = element_init(ObjMesh, mesh);
+    module_insert(md, e);
+}
 
-    // Subdivide r in z:
-    for (int i = 0; i < 4; i++) {
-        rUp.ctrls[i + 1 * 4].val[0] = (r.ctrls[i].val[0] + r.ctrls[i + 1 * 4].val[0]) / 2;
-        rUp.ctrls[i + 1 * 4].val[1] = (r.ctrls[i].val[1] + r.ctrls[i + 1 * 4].val[1]) / 2;
-        rUp.ctrls[i + 1 * 4].val[2] = (r.ctrls[i].val[2] + r.ctrls[i + 1 * 4].val[2]) / 2;
-
-        rUp.ctrls[i + 2 * 4].val[0] = (rUp.ctrls[i + 1 * 4].val[0] / 2) + (r.ctrls[i + 1 * 4].val[0] + r.ctrls[i + 2 * 4].val[0]) / 4;
-        rUp.ctrls[i + 2 * 4].val[1] = (rUp.ctrls[i + 1 * 4].val[1] / 2) + (r.ctrls[i + 1 * 4].val[1] + r.ctrls[i + 2 * 4].val[1]) / 4;
-        rUp.ctrls[i + 2 * 4].val[2] = (rUp.ctrls[i + 1 * 4].val[2] / 2) + (r.ctrls[i + 1 * 4].val[2] + r.ctrls[i + 2 * 4].val[2]) / 4;
-
-        rDown.ctrls[i + 2 * 4].val[0] = (r.ctrls[i + 2 * 4].val[0] + r.ctrls[i + 3 * 4].val[0]) / 2;
-        rDown.ctrls[i + 2 * 4].val[1] = (r.ctrls[i + 2 * 4].val[1] + r.ctrls[i + 3 * 4].val[1]) / 2;
-        rDown.ctrls[i + 2 * 4].val[2] = (r.ctrls[i + 2 * 4].val[2] + r.ctrls[i + 3 * 4].val[2]) / 2;
-
-        rDown.ctrls[i + 1 * 4].val[0] = (rDown.ctrls[i + 2 * 4].val[0] / 2) + (r.ctrls[i + 1 * 4].val[0] + r.ctrls[i + 2 * 4].val[0]) / 4;
-        rDown.ctrls[i + 1 * 4].val[1] = (rDown.ctrls[i + 2 * 4].val[1] / 2) + (r.ctrls[i + 1 * 4].val[1] + r.ctrls[i + 2 * 4].val[1]) / 4;
-        rDown.ctrls[i + 1 * 4].val[2] = (rDown.ctrls[i + 2 * 4].val[2] / 2) + (r.ctrls[i + 1 * 4].val[2] + r.ctrls[i + 2 * 4].val[2]) / 4;
-
-        rUp.ctrls[i + 3 * 4].val[0] = (rUp.ctrls[i + 2 * 4].val[0] + rDown.ctrls[i + 1 * 4].val[0]) / 2;
-        rUp.ctrls[i + 3 * 4].val[1] = (rUp.ctrls[i + 2 * 4].val[1] + rDown.ctrls[i + 1 * 4].val[1]) / 2;
-        rUp.ctrls[i + 3 * 4].val[2] = (rUp.ctrls[i + 2 * 4].val[2] + rDown.ctrls[i + 1 * 4].val[2]) / 2;
-
-        point_copy(&rDown.ctrls[i], &rUp.ctrls[i + 3 * 4]);
+/*
+    Set n to the unit sum of the area weighted normals of two faces, the
+    smooth normal along an edge they share.
+ */
+static void smoothNormal(Vector *a, Vector *b, Vector *n) {
+    vector_set(n, a->val[0] + b->val[0], a->val[1] + b->val[1],
+               a->val[2] + b->val[2]);
+    if (vector_length(n) > 0.0) {
+        vector_normalize(n);
     }
-
-    module_bezierSurface(m, &qUp, divisions-1, solid);
-    module_bezierSurface(m, &qDown, divisions-1, solid);
-    module_bezierSurface(m, &rUp, divisions-1, solid);
-    module_bezierSurface(m, &rDown, divisions-1, solid);
 }
 
 /**
- * Makes a unit cylinder at the origin. 
+ * Makes a unit cylinder at the origin. The vertex normals of the sides are
+ * smoothed across their shared edges, weighting each side by its area, while
+ * the ends keep their face normals.
  * 
  * This function is directly adapted from code provided by Bruce Maxwell in the 
  * file test6d.c.
@@ -1014,12 +1443,39 @@ void module_cylinder(Module *md, int sides) {
     Polygon p;
     Point xtop, xbot;
     double x1, x2, z1, z2;
+    Vector *face; // area weighted normal of each side
+    Vector n1, n2;
     int i;
 
+    face = malloc(sizeof(Vector) * sides);
+    if (!face) {
+        printf("module_cylinder(): malloc failed.\n");
+        return;
+    }
+
     polygon_init( &p );
+    polygon_setSided( &p, 1 ); // closed, wound counter-clockwise from outside
     point_set3D( &xtop, 0, 1.0, 0.0 );
     point_set3D( &xbot, 0, 0.0, 0.0 );
 
+    // Find the normal of every side first, to smooth the edges they share
+    for(i=0;i<sides;i++) {
+      Point pt[4];
+
+      x1 = cos( i * M_PI * 2.0 / sides );
+      z1 = sin( i * M_PI * 2.0 / sides );
+      x2 = cos( ( (i+1)%sides ) * M_PI * 2.0 / sides );
+      z2 = sin( ( (i+1)%sides ) * M_PI * 2.0 / sides );
+
+      point_set3D( &pt[0], x1, 0.0, z1 );
+      point_set3D( &pt[1], x1, 1.0, z1 );
+      point_set3D( &pt[2], x2, 1.0, z2 );
+      point_set3D( &pt[3], x2, 0.0, z2 );
+
+      polygon_set( &p, 4, pt );
+      polygon_faceNormal( &p, &face[i] );
+    }
+
     // make a fan for the top and bottom sides
     // and quadrilaterals for the sides
     for(i=0;i<sides;i++) {
@@ -1035,11 +1491,12 @@ void module_cylinder(Module *md, int sides) {
 
       // copy those points into pt[]
       point_copy( &pt[0], &xtop );
-      point_set3D( &pt[1], x1, 1.0, z1 );
-      point_set3D( &pt[2], x2, 1.0, z2 );
+      point_set3D( &pt[1], x2, 1.0, z2 );
+      point_set3D( &pt[2], x1, 1.0, z1 );
 
-      // Set a polygon for the fan:
+      // Set a polygon for the fan, which is flat:
       polygon_set( &p, 3, pt );
+      polygon_setFaceNormals( &p );
       module_polygon( md, &p );
 
       // Do the same for the bottom:
@@ -1048,25 +1505,36 @@ void module_cylinder(Module *md, int sides) {
       point_set3D( &pt[2], x2, 0.0, z2 );
 
       polygon_set( &p, 3, pt );
+      polygon_setFaceNormals( &p );
       module_polygon( md, &p );
 
       // Link the top and bottom with a rectangular side
       point_set3D( &pt[0], x1, 0.0, z1 );
-      point_set3D( &pt[1], x2, 0.0, z2 );
+      point_set3D( &pt[1], x1, 1.0, z1 );
       point_set3D( &pt[2], x2, 1.0, z2 );
-      point_set3D( &pt[3], x1, 1.0, z1 );
+      point_set3D( &pt[3], x2, 0.0, z2 );
 
+      // whose edges are smoothed with the neighbouring sides
       polygon_set( &p, 4, pt );
+      smoothNormal( &face[(i+sides-1)%sides], &face[i], &n1 );
+      smoothNormal( &face[i], &face[(i+1)%sides], &n2 );
+      vector_copy( &p.normal[0], &n1 );
+      vector_copy( &p.normal[1], &n1 );
+      vector_copy( &p.normal[2], &n2 );
+      vector_copy( &p.normal[3], &n2 );
       module_polygon( md, &p );
     }
 
     polygon_clear( &p );
+    free( face );
 }
 
 /**
  * Insert a unit cone with <sides> subdivisions centered at the origin. Note
  * that this does not create a smooth surface, but rather a subdivision surface.
- * So, for instance, setting sides to 4 will create a unit pyramid.
+ * So, for instance, setting sides to 4 will create a unit pyramid. The
+ * vertex normals are smoothed across the shared edges of the sides, so shading
+ * makes it look round all the same.
  * 
  * Adapted from Cylinder code provide by Bruce Maxwell.
  */
@@ -1074,12 +1542,37 @@ void module_cone(Module *md, int sides) {
     Polygon p;
     Point xtop, xbot;
     double x1, x2, z1, z2;
+    Vector *face; // area weighted normal of each side
+    Vector n1, n2;
     int i;
 
+    face = malloc(sizeof(Vector) * sides);
+    if (!face) {
+        printf("module_cone(): malloc failed.\n");
+        return;
+    }
+
     polygon_init( &p );
     point_set3D( &xtop, 0, 1.0, 0.0 );
     point_set3D( &xbot, 0, 0.0, 0.0 );
 
+    // Find the normal of every side first, to smooth the edges they share
+    for(i=0;i<sides;i++) {
+      Point pt[3];
+
+      x1 = cos( i * M_PI * 2.0 / sides );
+      z1 = sin( i * M_PI * 2.0 / sides );
+      x2 = cos( ( (i+1)%sides ) * M_PI * 2.0 / sides );
+      z2 = sin( ( (i+1)%sides ) * M_PI * 2.0 / sides );
+
+      point_set3D( &pt[0], x2, 0.0, z2 );
+      point_set3D( &pt[1], x1, 0.0, z1 );
+      point_copy( &pt[2], &xtop );
+
+      polygon_set( &p, 3, pt );
+      polygon_faceNormal( &p, &face[i] );
+    }
+
     // make a fan for the top and bottom sides
     // and triangles for the sides
     for(i=0;i<sides;i++) {
@@ -1102,20 +1595,29 @@ void module_cone(Module *md, int sides) {
       polygon_set( &p, 2, pt );
       module_polygon( md, &p );
 
-      // Link the top and bottom with a triangular side
-      point_set3D( &pt[0], x1, 0.0, z1 );
-      point_set3D( &pt[1], x2, 0.0, z2 );
+      /* Link the top and bottom with a triangular side, wound
+      counter-clockwise from outside. The base edges are smoothed with the
+      neighbouring sides; the tip, which every side shares, takes this
+      side's own normal */
+      point_set3D( &pt[0], x2, 0.0, z2 );
+      point_set3D( &pt[1], x1, 0.0, z1 );
       point_copy( &pt[2], &xtop);
 
       polygon_set( &p, 3, pt );
+      smoothNormal( &face[i], &face[(i+1)%sides], &n2 );
+      smoothNormal( &face[(i+sides-1)%sides], &face[i], &n1 );
+      vector_copy( &p.normal[0], &n2 );
+      vector_copy( &p.normal[1], &n1 );
+      smoothNormal( &face[i], &face[i], &p.normal[2] );
       module_polygon( md, &p );
     }
 
     polygon_clear( &p );
+    free( face );
 }
 
 /**
- * Inserts a tetrahedron into the module.
+ * Inserts a tetrahedron with face normals into the module.
  */
 void module_tetrahedron(Module *md) {
     const float inverseSqrt2 = 0.70710678118;
@@ -1127,25 +1629,28 @@ void module_tetrahedron(Module *md) {
     polygon_init(&p);
     Point vlist[3];
     polygon_set(&p, 3, pts);
+    polygon_setFaceNormals(&p);
     module_polygon(md, &p);
 
     point_copy(&vlist[0], &pts[0]);
     point_copy(&vlist[1], &pts[2]);
     point_copy(&vlist[2], &pts[3]);
     polygon_set(&p, 3, vlist);
+    polygon_setFaceNormals(&p);
     module_polygon(md, &p);
 
     point_copy(&vlist[0], &pts[0]);
     point_copy(&vlist[1], &pts[1]);
     point_copy(&vlist[2], &pts[3]);
     polygon_set(&p, 3, vlist);
+    polygon_setFaceNormals(&p);
     module_polygon(md, &p);
 
     polygon_clear(&p);
 }
 
 /**
- * Inserts an octahedron into the module
+ * Inserts an octahedron with face normals into the module
  */
 void module_octahedron(Module *md){
     Point pts[6] = {{{1.0,  0.0,  0.0, 1.0}}, 
@@ -1155,55 +1660,33 @@ void module_octahedron(Module *md){
                     {{0.0,  0.0,  1.0, 1.0}}, 
                     {{0.0,  0.0, -1.0, 1.0}}};
 
+    /* One face per octant as indices into pts, wound counter-clockwise as
+    seen from outside so the faces can be drawn one-sided */
+    int face[8][3] = {{0, 2, 4}, {1, 4, 2}, {0, 5, 2}, {1, 2, 5}, // top
+                      {0, 4, 3}, {1, 3, 4}, {0, 3, 5}, {1, 5, 3}}; // bottom
+
     Polygon p;
     polygon_init(&p);
+    polygon_setSided(&p, 1);
     Point vlist[3];
 
-    // top
-    point_copy(&vlist[0], &pts[0]);
-    point_copy(&vlist[1], &pts[4]);
-    point_copy(&vlist[2], &pts[2]);
-    polygon_set(&p, 3, vlist);
-    module_polygon(md, &p);
-
-    point_copy(&vlist[0], &pts[1]);
-    polygon_set(&p, 3, vlist);
-    module_polygon(md, &p);
-
-    point_copy(&vlist[0], &pts[0]);
-    point_copy(&vlist[1], &pts[5]);
-    polygon_set(&p, 3, vlist);
-    module_polygon(md, &p);
-
-    point_copy(&vlist[0], &pts[1]);
-    polygon_set(&p, 3, vlist);
-    module_polygon(md, &p);
-
-    // Bottom:
-    point_copy(&vlist[0], &pts[0]);
-    point_copy(&vlist[1], &pts[4]);
-    point_copy(&vlist[2], &pts[3]);
-    polygon_set(&p, 3, vlist);
-    module_polygon(md, &p);
-
-    point_copy(&vlist[0], &pts[1]);
-    polygon_set(&p, 3, vlist);
-    module_polygon(md, &p);
-
-    point_copy(&vlist[0], &pts[0]);
-    point_copy(&vlist[1], &pts[5]);
-    polygon_set(&p, 3, vlist);
-    module_polygon(md, &p);
-
-    point_copy(&vlist[0], &pts[1]);
-    polygon_set(&p, 3, vlist);
-    module_polygon(md, &p);
+    for (int f = 0; f < 8; f++) {
+        for (int k = 0; k < 3; k++) {
+            point_copy(&vlist[k], &pts[face[f][k]]);
+        }
+        polygon_set(&p, 3, vlist);
+        polygon_setFaceNormals(&p);
+        module_polygon(md, &p);
+    }
 
     polygon_clear(&p);
 }
 
 /**
- * Adds the Utah Teapot to the module, defined by a bunch of Bezier Surfaces.
+ * Adds the Utah Teapot to the module, defined by a bunch of Bezier Surfaces
+ * that are each tessellated into a solid triangle mesh. The patches stay
+ * two-sided: the teapot has no bottom and its spout is open, so its inside
+ * can be seen.
  * 
  * Vertices were pulled from:
  * https://www.sjbaker.org/wiki/index.php?title=The_History_of_The_Teapot
@@ -1297,65 +1780,65 @@ void module_teapot(Module *md, int subdivisions) {
         point_copy(&s.ctrls[i], &vlist[rim[i]]);
     }
     module_rotateX(md, 0, -1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     
     // Add the body:
     for (int i = 0; i < 16; i++) {
         point_copy(&s.ctrls[i], &vlist[body_1[i]]);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
 
     for (int i = 0; i < 16; i++) {
         point_copy(&s.ctrls[i], &vlist[body_2[i]]);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
 
     // Add the lid:
     for (int i = 0; i < 16; i++) {
         point_copy(&s.ctrls[i], &vlist[lid_1[i]]);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     
     for (int i = 0; i < 16; i++) {
         point_copy(&s.ctrls[i], &vlist[lid_2[i]]);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     module_rotateY(md, 0, 1);
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
 
     // Add the handle:
     for (int i = 0; i < 16; i++) { // 1st patch
         point_copy(&s.ctrls[i], &vlist[handle_1[i]]);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     
     for (int i = 0; i < 16; i++) { // reflected 1st patch
         Point pt;
@@ -1363,12 +1846,12 @@ void module_teapot(Module *md, int subdivisions) {
         pt.val[1] = -pt.val[1];
         point_copy(&s.ctrls[i], &pt);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     
     for (int i = 0; i < 16; i++) { // 2nd patch
         point_copy(&s.ctrls[i], &vlist[handle_2[i]]);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
 
     for (int i = 0; i < 16; i++) { // reflected 2nd patch
         Point pt;
@@ -1376,14 +1859,13 @@ void module_teapot(Module *md, int subdivisions) {
         pt.val[1] = -pt.val[1];
         point_copy(&s.ctrls[i], &pt);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
 
     // Add the spout:
     for (int i = 0; i < 16; i++) { // 1/2 of base
         point_copy(&s.ctrls[i], &vlist[spout_1[i]]);
-        point_print(&s.ctrls[i], stdout);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     
     for (int i = 0; i < 16; i++) { // reflected 1/2 of base
         Point pt;
@@ -1391,12 +1873,12 @@ void module_teapot(Module *md, int subdivisions) {
         pt.val[1] = -pt.val[1];
         point_copy(&s.ctrls[i], &pt);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
     
     for (int i = 0; i < 16; i++) { // 1/2 of tip
         point_copy(&s.ctrls[i], &vlist[spout_2[i]]);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
 
     for (int i = 0; i < 16; i++) { // reflected 1/2 of tip
         Point pt;
@@ -1404,7 +1886,7 @@ void module_teapot(Module *md, int subdivisions) {
         pt.val[1] = -pt.val[1];
         point_copy(&s.ctrls[i], &pt);
     }
-    module_bezierSurface(md, &s, subdivisions, 0);
+    module_bezierSurface(md, &s, subdivisions, 1);
 }
 
 /* SHADING/COLOR MODULE FUNCTIONS */
@@ -1419,13 +1901,7 @@ void module_color(Module *md, Color *c) {
     }
 
     Element *e = element_init(ObjColor, c);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -1438,13 +1914,7 @@ void module_bodyColor(Module  *md, Color *c) {
     }
 
     Element *e = element_init(ObjBodyColor, c);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -1457,13 +1927,7 @@ void module_surfaceColor(Module *md, Color *c) {
     }
 
     Element *e = element_init(ObjSurfaceColor, c);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
-    }
+    module_insert(md, e);
 }
 
 /**
@@ -1476,11 +1940,20 @@ void module_surfaceCoeff(Module *md, float coeff) {
     }
 
     Element *e = element_init(ObjSurfaceCoeff, &coeff);
-    if (!md->tail) {
-        md->head = e;
-        md->tail = e;
-    } else {
-        md->tail->next = e; // Set the last element in the list to point to e
-        md->tail = e; // Set the last element to be e.
+    module_insert(md, e);
+}
+
+/**
+ * Add a copy of the light to the tail of the module's list. The light is
+ * placed by the transformations in effect where it is added, like any other
+ * primitive, and lights everything in the scene drawn with the module.
+ */
+void module_light(Module *md, Light *light) {
+    if (!md || !light) {
+        printf("module_light(): passed null pointer.\n");
+        return;
     }
+
+    Element *e = element_init(ObjLight, light);
+    module_insert(md, e);
 }
\ No newline at end of file
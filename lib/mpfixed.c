@@ -0,0 +1,265 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Implements mpfixed.h. All arithmetic truncates below the last limb of the
+ * less precise operand. Results are computed into a temporary first, so r may
+ * alias a or b.
+ */
+#include <ctype.h>
+#include "graphicslib.h"
+#include "mpfixed.h"
+
+/**
+ * Return the precision two operands share.
+ */
+static int mp_common(MPFixed *a, MPFixed *b) {
+    return a->limbs < b->limbs ? a->limbs : b->limbs;
+}
+
+/**
+ * Compare the magnitudes of a and b over n limbs; returns <0, 0 or >0.
+ */
+static int mp_cmpMag(const uint32_t *a, const uint32_t *b, int n) {
+    for (int i = 0; i < n; i++) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static void mp_addMag(const uint32_t *a, const uint32_t *b, uint32_t *r, int n) {
+    uint64_t carry = 0;
+
+    for (int i = n - 1; i >= 0; i--) {
+        uint64_t sum = (uint64_t) a[i] + b[i] + carry;
+        r[i] = (uint32_t) sum;
+        carry = sum >> 32;
+    }
+}
+
+/* Requires |a| >= |b| */
+static void mp_subMag(const uint32_t *a, const uint32_t *b, uint32_t *r, int n) {
+    int64_t borrow = 0;
+
+    for (int i = n - 1; i >= 0; i--) {
+        int64_t diff = (int64_t) a[i] - b[i] - borrow;
+        borrow = diff < 0;
+        r[i] = (uint32_t) (diff + (borrow << 32));
+    }
+}
+
+/**
+ * Divide the magnitude of a by the small integer d in place.
+ */
+static void mp_divSmall(MPFixed *a, uint32_t d) {
+    uint64_t rem = 0;
+
+    for (int i = 0; i < a->limbs; i++) {
+        uint64_t cur = (rem << 32) | a->limb[i];
+        a->limb[i] = (uint32_t) (cur / d);
+        rem = cur % d;
+    }
+}
+
+/**
+ * Multiply the magnitude of a by the small integer m in place.
+ */
+static void mp_mulSmall(MPFixed *a, uint32_t m) {
+    uint64_t carry = 0;
+
+    for (int i = a->limbs - 1; i >= 0; i--) {
+        uint64_t cur = (uint64_t) a->limb[i] * m + carry;
+        a->limb[i] = (uint32_t) cur;
+        carry = cur >> 32;
+    }
+}
+
+/**
+ * Return the number of limbs needed to resolve differences of the given size
+ * (e.g. the width of a pixel) with a comfortable margin, capped at MP_LIMBS.
+ */
+int mp_limbsFor(double resolution) {
+    int bits, limbs;
+
+    if (resolution <= 0.0) {
+        return MP_LIMBS;
+    }
+    bits = (int) ceil(-log2(resolution)) + 64;
+    limbs = 1 + (bits + 31) / 32;
+    if (limbs < 2) {
+        return 2;
+    }
+    return limbs > MP_LIMBS ? MP_LIMBS : limbs;
+}
+
+/**
+ * Set a to the double v with the given number of limbs.
+ */
+void mp_set(MPFixed *a, double v, int limbs) {
+    double mag = fabs(v);
+
+    if (!a) {
+        printf("mp_set(): passed NULL pointer.\n");
+        return;
+    }
+
+    a->limbs = limbs < 2 ? 2 : (limbs > MP_LIMBS ? MP_LIMBS : limbs);
+    a->sign = v < 0 ? -1 : 1;
+    for (int i = 0; i < a->limbs; i++) {
+        double whole = floor(mag);
+        a->limb[i] = (uint32_t) whole;
+        mag = (mag - whole) * 4294967296.0;
+    }
+}
+
+/**
+ * Set a to the decimal number in s, e.g. "-0.743643887037158704752191506114774"
+ * or "1.5e-3", keeping every digit up to the precision of the given number of
+ * limbs. Returns 0 on success or -1 if s is not a number.
+ */
+int mp_setString(MPFixed *a, const char *s, int limbs) {
+    const char *p, *point, *end;
+    uint64_t whole = 0;
+    int exponent = 0, digits = 0;
+
+    if (!a || !s) {
+        printf("mp_setString(): passed NULL pointer.\n");
+        return -1;
+    }
+
+    mp_set(a, 0.0, limbs);
+    while (isspace((unsigned char) *s)) {
+        s++;
+    }
+    if (*s == '-' || *s == '+') {
+        a->sign = *s == '-' ? -1 : 1;
+        s++;
+    }
+
+    // Integer part
+    for (p = s; isdigit((unsigned char) *p); p++) {
+        whole = whole * 10 + (*p - '0');
+        if (whole > UINT32_MAX) {
+            return -1;
+        }
+        digits++;
+    }
+
+    // Fraction, accumulated from its last digit: f = (f + d) / 10
+    point = p;
+    if (*p == '.') {
+        for (p++; isdigit((unsigned char) *p); p++) {
+            digits++;
+        }
+    }
+    end = p;
+    if (*point == '.') {
+        for (p = end - 1; p > point; p--) {
+            a->limb[0] += *p - '0';
+            mp_divSmall(a, 10);
+        }
+    }
+    a->limb[0] += (uint32_t) whole;
+
+    if (!digits) {
+        return -1;
+    }
+
+    // Optional exponent
+    p = end;
+    if (*p == 'e' || *p == 'E') {
+        char *after;
+        exponent = (int) strtol(p + 1, &after, 10);
+        if (after == p + 1) {
+            return -1;
+        }
+        p = after;
+    }
+    for (; exponent > 0; exponent--) {
+        mp_mulSmall(a, 10);
+    }
+    for (; exponent < 0; exponent++) {
+        mp_divSmall(a, 10);
+    }
+
+    while (isspace((unsigned char) *p)) {
+        p++;
+    }
+    return *p ? -1 : 0;
+}
+
+/**
+ * Return a rounded to the nearest double (to within a few ulps).
+ */
+double mp_toDouble(MPFixed *a) {
+    double v = 0.0;
+    int n = a->limbs < 4 ? a->limbs : 4;
+
+    for (int i = n - 1; i >= 0; i--) {
+        v = v / 4294967296.0 + a->limb[i];
+    }
+    return a->sign * v;
+}
+
+/**
+ * r = a + b
+ */
+void mp_add(MPFixed *a, MPFixed *b, MPFixed *r) {
+    MPFixed t;
+    int n = mp_common(a, b);
+
+    t.limbs = n;
+    if (a->sign == b->sign) {
+        t.sign = a->sign;
+        mp_addMag(a->limb, b->limb, t.limb, n);
+    } else if (mp_cmpMag(a->limb, b->limb, n) >= 0) {
+        t.sign = a->sign;
+        mp_subMag(a->limb, b->limb, t.limb, n);
+    } else {
+        t.sign = b->sign;
+        mp_subMag(b->limb, a->limb, t.limb, n);
+    }
+    *r = t;
+}
+
+/**
+ * r = a - b
+ */
+void mp_sub(MPFixed *a, MPFixed *b, MPFixed *r) {
+    MPFixed negB = *b;
+
+    negB.sign = -b->sign;
+    mp_add(a, &negB, r);
+}
+
+/**
+ * r = a * b, by schoolbook multiplication of the limbs.
+ */
+void mp_mul(MPFixed *a, MPFixed *b, MPFixed *r) {
+    uint64_t acc[MP_LIMBS + 2] = {0};
+    MPFixed t;
+    int n = mp_common(a, b);
+
+    // Limb i of a times limb j of b has weight 2^(-32 (i + j)); its low word
+    // lands in column i + j + 1 and its high word in column i + j. Column
+    // n + 1 is only kept to carry into the last limb.
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n && i + j <= n; j++) {
+            uint64_t prod = (uint64_t) a->limb[i] * b->limb[j];
+            acc[i + j + 1] += (uint32_t) prod;
+            acc[i + j] += prod >> 32;
+        }
+    }
+    for (int k = n + 1; k > 0; k--) {
+        acc[k - 1] += acc[k] >> 32;
+        acc[k] &= 0xFFFFFFFFu;
+    }
+
+    t.limbs = n;
+    t.sign = a->sign * b->sign;
+    for (int k = 0; k < n; k++) {
+        t.limb[k] = (uint32_t) acc[k + 1];
+    }
+    *r = t;
+}
@@ -0,0 +1,258 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Implements palette.h. Coloring is a table lookup per pixel, spread over rows
+ * with parallel_for(); no transcendental functions are evaluated per pixel.
+ */
+#include "graphicslib.h"
+
+/**
+ * Allocate an IterBuffer for a rows x cols image whose counts lie in
+ * [0, maxIter). Counts are stored in 16 bits when they fit and smooth is 0,
+ * and in 32 bits otherwise. The counts start at 0.
+ */
+IterBuffer *iterbuffer_create(int rows, int cols, int maxIter, int smooth) {
+    IterBuffer *b = malloc(sizeof(IterBuffer));
+    size_t n = (size_t) (rows > 0 ? rows : 0) * (cols > 0 ? cols : 0);
+
+    if (!b) {
+        printf("iterbuffer_create(): malloc() failed.\n");
+        return NULL;
+    }
+
+    b->rows = rows;
+    b->cols = cols;
+    b->maxIter = maxIter;
+    b->smooth = smooth ? 1 : 0;
+    b->u16 = NULL;
+    b->u32 = NULL;
+    if (!b->smooth && maxIter <= UINT16_MAX + 1) {
+        b->u16 = calloc(n ? n : 1, sizeof(uint16_t));
+    } else {
+        b->u32 = calloc(n ? n : 1, sizeof(uint32_t));
+    }
+
+    if (!b->u16 && !b->u32) {
+        printf("iterbuffer_create(): malloc() failed.\n");
+        free(b);
+        return NULL;
+    }
+
+    return b;
+}
+
+void iterbuffer_free(IterBuffer *b) {
+    if (!b) {
+        printf("iterbuffer_free(): passed NULL pointer.\n");
+        return;
+    }
+
+    free(b->u16);
+    free(b->u32);
+    free(b);
+}
+
+/**
+ * Store row i of the buffer from the integer counts of its pixels. frac holds
+ * the fraction in [0, 1) to add to each count of a smooth buffer; it may be
+ * NULL, and is ignored if the buffer is not smooth.
+ */
+void iterbuffer_setRow(IterBuffer *b, int i, const int *counts,
+                       const float *frac) {
+    size_t base;
+
+    if (!b || !counts) {
+        printf("iterbuffer_setRow(): passed NULL pointer.\n");
+        return;
+    }
+
+    base = (size_t) i * b->cols;
+    if (b->u16) {
+        for (int j = 0; j < b->cols; j++) {
+            b->u16[base + j] = (uint16_t) counts[j];
+        }
+    } else if (b->smooth) {
+        for (int j = 0; j < b->cols; j++) {
+            uint32_t f = frac ? (uint32_t) (frac[j] * PALETTE_FRAC_ONE) : 0;
+            if (f >= PALETTE_FRAC_ONE) {
+                f = PALETTE_FRAC_ONE - 1;
+            }
+            b->u32[base + j] = ((uint32_t) counts[j] << PALETTE_FRAC_BITS) | f;
+        }
+    } else {
+        for (int j = 0; j < b->cols; j++) {
+            b->u32[base + j] = (uint32_t) counts[j];
+        }
+    }
+}
+
+/**
+ * Return the fraction of an iteration to add to the count of an orbit that
+ * left the radius-2 disk at z, for smooth coloring: 1 - log2(log2 |z|),
+ * clamped to [0, 1). Orbits that never escaped get 0.
+ */
+float iterbuffer_smooth(float zx, float zy) {
+    double mag = (double) zx * zx + (double) zy * zy;
+    double f;
+
+    if (!(mag > 4.0)) {
+        return 0.0f;
+    }
+    f = 1.0 - log2(0.5 * log2(mag));
+    if (f < 0.0) {
+        return 0.0f;
+    }
+    return f < 1.0 ? f : 0.999f;
+}
+
+/**
+ * Allocate a black Palette with size entries.
+ */
+Palette *palette_create(int size) {
+    Palette *p;
+
+    if (size <= 0) {
+        printf("palette_create(): size must be positive.\n");
+        return NULL;
+    }
+
+    p = malloc(sizeof(Palette));
+    if (!p) {
+        printf("palette_create(): malloc() failed.\n");
+        return NULL;
+    }
+    p->size = size;
+    p->lut = calloc(size, sizeof(FPixel));
+    if (!p->lut) {
+        printf("palette_create(): malloc() failed.\n");
+        free(p);
+        return NULL;
+    }
+
+    return p;
+}
+
+void palette_free(Palette *p) {
+    if (!p) {
+        printf("palette_free(): passed NULL pointer.\n");
+        return;
+    }
+
+    free(p->lut);
+    free(p);
+}
+
+/**
+ * The palette the fractals have always been drawn with: log(n) in the red
+ * channel and 1 / log(n) in the given channel (1 or 2), for counts below
+ * maxIter.
+ */
+Palette *palette_createLog(int maxIter, int channel) {
+    Palette *p = palette_create(maxIter);
+
+    if (!p) {
+        return NULL;
+    }
+    for (int n = 0; n < maxIter; n++) {
+        p->lut[n].rgb[0] = log((double) n);
+        p->lut[n].rgb[channel] = 1.0 / log(((double) n));
+    }
+
+    return p;
+}
+
+/**
+ * A palette of size entries blending evenly through the nStops colors, from
+ * stops[0] at count 0 to stops[nStops - 1] at the last entry.
+ */
+Palette *palette_createGradient(int size, Color *stops, int nStops) {
+    Palette *p;
+
+    if (!stops) {
+        printf("palette_createGradient(): passed NULL pointer.\n");
+        return NULL;
+    }
+    if (nStops <= 0) {
+        printf("palette_createGradient(): need at least one stop.\n");
+        return NULL;
+    }
+
+    p = palette_create(size);
+    if (!p) {
+        return NULL;
+    }
+    for (int n = 0; n < size; n++) {
+        float t = size > 1 ? (float) n * (nStops - 1) / (size - 1) : 0.0f;
+        int s = (int) t;
+        if (s >= nStops - 1) {
+            s = nStops - 1;
+            t = s;
+        }
+        float f = t - s;
+        int s1 = s + 1 < nStops ? s + 1 : s;
+        for (int c = 0; c < 3; c++) {
+            p->lut[n].rgb[c] = stops[s].c[c] * (1 - f) + stops[s1].c[c] * f;
+        }
+    }
+
+    return p;
+}
+
+typedef struct {
+    Palette *p;
+    IterBuffer *b;
+    Image *im;
+} PaletteJob;
+
+static void palette_applyRow(int i, int worker, void *arg) {
+    PaletteJob *job = arg;
+    const FPixel *lut = job->p->lut;
+    uint32_t last = job->p->size - 1;
+    size_t base = (size_t) i * job->b->cols;
+    FPixel *dst = job->im->data + (size_t) i * job->im->cols;
+    int cols = job->b->cols;
+
+    if (job->b->u16) {
+        const uint16_t *src = job->b->u16 + base;
+        for (int j = 0; j < cols; j++) {
+            dst[j] = lut[src[j] < last ? src[j] : last];
+        }
+    } else if (!job->b->smooth) {
+        const uint32_t *src = job->b->u32 + base;
+        for (int j = 0; j < cols; j++) {
+            dst[j] = lut[src[j] < last ? src[j] : last];
+        }
+    } else {
+        // Blend entry n with entry n + 1 by the fraction
+        const uint32_t *src = job->b->u32 + base;
+        for (int j = 0; j < cols; j++) {
+            uint32_t n = src[j] >> PALETTE_FRAC_BITS;
+            float f = (src[j] & (PALETTE_FRAC_ONE - 1)) *
+                      (1.0f / PALETTE_FRAC_ONE);
+            const FPixel *a = &lut[n < last ? n : last];
+            const FPixel *b = &lut[n + 1 < last ? n + 1 : last];
+            for (int c = 0; c < 3; c++) {
+                dst[j].rgb[c] = a->rgb[c] + (b->rgb[c] - a->rgb[c]) * f;
+            }
+        }
+    }
+}
+
+/**
+ * Color every pixel of im from its count in b through the palette. im must
+ * be the same size as b. Rows are colored in parallel.
+ */
+void palette_apply(Palette *p, IterBuffer *b, Image *im) {
+    PaletteJob job = {p, b, im};
+
+    if (!p || !b || !im) {
+        printf("palette_apply(): passed NULL pointer.\n");
+        return;
+    }
+    if (im->rows != b->rows || im->cols != b->cols) {
+        printf("palette_apply(): image and buffer sizes differ.\n");
+        return;
+    }
+
+    parallel_for(b->rows, palette_applyRow, &job);
+}
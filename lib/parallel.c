@@ -0,0 +1,198 @@
+/**
+ * David J Anderson - November 2021
+ *
+ * Implements parallel.h. The worker threads are started the first time
+ * parallel_for() needs them and then kept, asleep on a condition variable
+ * between loops, so a loop costs a wake-up rather than a thread start. The
+ * calling thread joins in as worker 0. Every worker repeatedly claims the
+ * next unprocessed index with an atomic fetch-and-add until the loop is
+ * exhausted (dynamic scheduling). A parallel_for() called from inside a task
+ * runs on the calling thread alone, since the outer loop already keeps every
+ * core busy.
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "graphicslib.h"
+#include "parallel.h"
+
+static int parallel_nThreads = 0; // 0 means one thread per online CPU
+static _Thread_local int parallel_inTask = 0; // running a parallel_for() task
+
+typedef struct {
+    atomic_int next; // next unclaimed work item
+    int count;
+    ParallelTask task;
+    void *arg;
+} ParallelJob;
+
+/* The pool. pool_lock guards everything but the job's counter. A loop is
+   published by bumping pool_generation; workers 1 .. pool_helpers take part,
+   and the caller waits on pool_done until pool_active of them have finished.
+   pool_call serializes loops started from unrelated threads. */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t pool_call = PTHREAD_MUTEX_INITIALIZER;
+static int pool_size = 0; // workers started, numbered 1 .. pool_size
+static unsigned long pool_generation = 0;
+static ParallelJob *pool_job = NULL;
+static int pool_helpers = 0; // workers taking part in the current loop
+static int pool_active = 0; // of those, the ones not yet finished
+static unsigned long pool_start[PARALLEL_MAX_THREADS]; // generation at start
+
+/**
+ * Claim and run work items until none are left.
+ */
+static void parallel_drain(ParallelJob *job, int worker) {
+    int i;
+
+    parallel_inTask = 1;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->count) {
+        job->task(i, worker, job->arg);
+    }
+    parallel_inTask = 0;
+}
+
+/*
+    A pool worker: sleep until a loop is published, help with it if its
+    number is low enough, and report back.
+ */
+static void *parallel_main(void *arg) {
+    int worker = (int) (long) arg;
+    unsigned long seen;
+    ParallelJob *job;
+
+    pthread_mutex_lock(&pool_lock);
+    seen = pool_start[worker];
+    for (;;) {
+        while (pool_generation == seen) {
+            pthread_cond_wait(&pool_ready, &pool_lock);
+        }
+        seen = pool_generation;
+        if (worker > pool_helpers) {
+            continue;
+        }
+        job = pool_job;
+        pthread_mutex_unlock(&pool_lock);
+
+        parallel_drain(job, worker);
+
+        pthread_mutex_lock(&pool_lock);
+        if (--pool_active == 0) {
+            pthread_cond_signal(&pool_done);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+    Start workers until the pool has n of them or a thread fails to start.
+    Called with pool_call held.
+ */
+static void parallel_grow(int n) {
+    while (pool_size < n) {
+        pthread_t thread;
+        int worker = pool_size + 1;
+
+        /* Only holders of pool_call publish loops, so the generation cannot
+        move before the worker starts waiting, however late that is */
+        pool_start[worker] = pool_generation;
+        if (pthread_create(&thread, NULL, parallel_main,
+                           (void *) (long) worker)) {
+            return;
+        }
+        pthread_detach(thread);
+        pthread_mutex_lock(&pool_lock);
+        pool_size = worker;
+        pthread_mutex_unlock(&pool_lock);
+    }
+}
+
+/**
+ * Return the number of threads parallel_for() will use.
+ */
+int parallel_threads(void) {
+    int n = parallel_nThreads;
+
+    if (n <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n = cpus > 0 ? (int) cpus : 1;
+    }
+
+    return n > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : n;
+}
+
+/**
+ * Set the number of threads parallel_for() uses. A value of 0 (the default)
+ * uses one thread per online CPU; 1 runs everything on the calling thread.
+ * Workers already started are kept, idle, when the count goes down. Should
+ * not be called while a parallel_for() is running.
+ */
+void parallel_setThreads(int n) {
+    parallel_nThreads = n < 0 ? 0 : n;
+}
+
+/**
+ * Call task(i, worker, arg) once for every i in [0, count), spreading the
+ * calls over parallel_threads() threads, and return when all have finished.
+ * Items are claimed in increasing order but may complete in any order, so
+ * tasks must only write to memory owned by their own index or worker. Called
+ * from within a task, the loop runs serially on the calling thread as
+ * worker 0, rather than waking the pool again.
+ */
+void parallel_for(int count, ParallelTask task, void *arg) {
+    ParallelJob job;
+    int nThreads;
+
+    if (!task) {
+        printf("parallel_for(): passed NULL pointer.\n");
+        return;
+    }
+    if (count <= 0) {
+        return;
+    }
+    if (parallel_inTask) {
+        for (int i = 0; i < count; i++) {
+            task(i, 0, arg);
+        }
+        return;
+    }
+
+    atomic_init(&job.next, 0);
+    job.count = count;
+    job.task = task;
+    job.arg = arg;
+
+    nThreads = parallel_threads();
+    if (nThreads > count) {
+        nThreads = count;
+    }
+    if (nThreads <= 1) {
+        parallel_drain(&job, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool_call);
+    parallel_grow(nThreads - 1);
+
+    // If the pool is short of threads the workers it has pick up the slack
+    pthread_mutex_lock(&pool_lock);
+    pool_job = &job;
+    pool_helpers = pool_size < nThreads - 1 ? pool_size : nThreads - 1;
+    pool_active = pool_helpers;
+    pool_generation++;
+    pthread_cond_broadcast(&pool_ready);
+    pthread_mutex_unlock(&pool_lock);
+
+    parallel_drain(&job, 0);
+
+    pthread_mutex_lock(&pool_lock);
+    while (pool_active > 0) {
+        pthread_cond_wait(&pool_done, &pool_lock);
+    }
+    pool_job = NULL;
+    pthread_mutex_unlock(&pool_lock);
+    pthread_mutex_unlock(&pool_call);
+}
@@ -56,7 +56,7 @@ Polygon *polygon_createp(int numV, Point *vlist) {
     }
 
     toReturn->nVertex = numV;
-    toReturn->oneSided = 1;
+    toReturn->oneSided = 0;
     toReturn->zBuffer = 1;
     toReturn->vertex = (Point *) malloc(sizeof(Point) * toReturn->nVertex);
     toReturn->color = (Color *) malloc(sizeof (Color) * toReturn->nVertex);
@@ -107,17 +107,20 @@ void polygon_init(Polygon *p) {
     p->vertex = NULL;
     p->nVertex = 0;
     p->zBuffer = 1;
-    p->oneSided = 1;
+    p->oneSided = 0;
 }
 
 /**
- * Initializes the vertex array to the points in vlist.
+ * Initializes the vertex array to the points in vlist. The polygon keeps its
+ * sidedness.
  */
 void polygon_set(Polygon *p, int numV, Point *vlist) {
     int i;
+    int oneSided = p->oneSided;
 
     // Free any existing data in the polygon:
     polygon_clear(p);
+    p->oneSided = oneSided;
 
     // Check number of input vectors
     if (numV < 0) {
@@ -195,14 +198,16 @@ void polygon_clear(Polygon *p) {
     }
 
     p->nVertex = 0;
-    p->oneSided = 1;
+    p->oneSided = 0;
     p->zBuffer = 1;
 }
 
 /**
  * Sets the oneSided field to the value. Argument <oneSided> can be either 0
  * (two-sided) or 1 (one-sided). If it is any value other than 0, it defaults
- * to setting the drawing style to one-sided (1).
+ * to setting the drawing style to one-sided (1). One-sided polygons must be
+ * wound counter-clockwise when seen from the front; module_draw() skips them
+ * when they face away from the viewer.
  */
 void polygon_setSided(Polygon *p, int oneSided) {
     if (oneSided == 0) {
@@ -297,6 +302,287 @@ void polygon_normalize(Polygon *p) {
     }
 }
 
+/**
+ * Put the polygon's face normal in n, found with Newell's method, which also
+ * copes with non-planar polygons. The normal points towards the side the
+ * polygon is wound counter-clockwise around and is not normalized: its
+ * length is twice the polygon's area, so summing the face normals around a
+ * vertex weights each face by its area.
+ */
+void polygon_faceNormal(Polygon *p, Vector *n) {
+    if (!p || !n) {
+        printf("polygon_faceNormal(): passed NULL pointer.\n");
+        return;
+    }
+
+    vector_set(n, 0.0, 0.0, 0.0);
+    for (int i = 0; i < p->nVertex; i++) {
+        Point *a = &p->vertex[i];
+        Point *b = &p->vertex[(i + 1) % p->nVertex];
+        n->val[0] += (a->val[1] - b->val[1]) * (a->val[2] + b->val[2]);
+        n->val[1] += (a->val[2] - b->val[2]) * (a->val[0] + b->val[0]);
+        n->val[2] += (a->val[0] - b->val[0]) * (a->val[1] + b->val[1]);
+    }
+}
+
+/**
+ * Set the normal of every vertex to the polygon's unit face normal, for
+ * faceted shading. Polygons with no area keep the normals they have.
+ */
+void polygon_setFaceNormals(Polygon *p) {
+    Vector n;
+
+    if (!p || !p->normal) {
+        printf("polygon_setFaceNormals(): passed NULL pointer.\n");
+        return;
+    }
+
+    polygon_faceNormal(p, &n);
+    if (vector_length(&n) == 0.0) {
+        return;
+    }
+    vector_normalize(&n);
+    for (int i = 0; i < p->nVertex; i++) {
+        vector_copy(&p->normal[i], &n);
+    }
+}
+
+/**
+ * Return 1 if the polygon, in normalized screen coordinates, is wound
+ * clockwise as seen on screen, i.e. a polygon wound counter-clockwise around
+ * its front faces away from the viewer. Polygons seen edge-on count as
+ * back-facing since they cover no pixels.
+ */
+int polygon_backFacing(Polygon *p) {
+    double area = 0.0;
+    Point *prev = &p->vertex[p->nVertex - 1];
+
+    // Twice the signed area from the shoelace formula; y points down
+    for (int i = 0; i < p->nVertex; i++) {
+        area += prev->val[0] * p->vertex[i].val[1] -
+                p->vertex[i].val[0] * prev->val[1];
+        prev = &p->vertex[i];
+    }
+
+    return area >= 0.0;
+}
+
+/**
+ * Set the clip volume to the extent of the image src and the near/far range
+ * of the DrawState ds, clipping against all six planes.
+ */
+void clipvolume_set(ClipVolume *cv, Image *src, DrawState *ds) {
+    if (!cv || !src || !ds) {
+        printf("clipvolume_set(): passed NULL pointer.\n");
+        return;
+    }
+
+    cv->cols = src->cols;
+    cv->rows = src->rows;
+    cv->hNear = ds->clipNear;
+    cv->hFar = ds->clipFar;
+    cv->planes = CLIP_ALL;
+}
+
+/**
+ * Return the outcode of a point in homogeneous screen coordinates: the set of
+ * CLIP_* bits for the planes of cv that the point lies outside of.
+ */
+int point_outcode(Point *pt, ClipVolume *cv) {
+    double h = pt->val[3];
+    int code = 0;
+
+    if (pt->val[0] < 0.0) {
+        code |= CLIP_LEFT;
+    }
+    if (pt->val[0] > cv->cols * h) {
+        code |= CLIP_RIGHT;
+    }
+    if (pt->val[1] < 0.0) {
+        code |= CLIP_TOP;
+    }
+    if (pt->val[1] > cv->rows * h) {
+        code |= CLIP_BOTTOM;
+    }
+    if (h < cv->hNear) {
+        code |= CLIP_NEAR;
+    }
+    if (h > cv->hFar) {
+        code |= CLIP_FAR;
+    }
+
+    return code & cv->planes;
+}
+
+/*
+    Signed distance of a homogeneous point from one clip plane, positive on
+    the inside. It is linear in the point, so the zero crossing along an edge
+    is found by linear interpolation.
+ */
+static double clipDistance(Point *pt, ClipVolume *cv, int plane) {
+    switch (plane) {
+    case CLIP_LEFT:
+        return pt->val[0];
+    case CLIP_RIGHT:
+        return cv->cols * pt->val[3] - pt->val[0];
+    case CLIP_TOP:
+        return pt->val[1];
+    case CLIP_BOTTOM:
+        return cv->rows * pt->val[3] - pt->val[1];
+    case CLIP_NEAR:
+        return pt->val[3] - cv->hNear;
+    default:
+        return cv->hFar - pt->val[3];
+    }
+}
+
+/*
+    One Sutherland-Hodgman pass: clip the n vertices in vin (with optional
+    colors cin and normals nin) against a single plane, writing the result to
+    the out arrays and returning its vertex count.
+ */
+static int clipPlane(int plane, ClipVolume *cv, int n, Point *vin, Color *cin,
+                     Vector *nin, Point *vout, Color *cout, Vector *nout) {
+    int m = 0;
+    int prev = n - 1;
+    double dPrev = clipDistance(&vin[prev], cv, plane);
+
+    for (int i = 0; i < n; i++) {
+        double d = clipDistance(&vin[i], cv, plane);
+
+        // The edge from prev to i crosses the plane; emit the intersection
+        if ((dPrev >= 0.0) != (d >= 0.0)) {
+            double t = dPrev / (dPrev - d);
+            for (int k = 0; k < 4; k++) {
+                vout[m].val[k] = vin[prev].val[k] +
+                                 t * (vin[i].val[k] - vin[prev].val[k]);
+            }
+            if (cin) {
+                for (int k = 0; k < 3; k++) {
+                    cout[m].c[k] = cin[prev].c[k] +
+                                   t * (cin[i].c[k] - cin[prev].c[k]);
+                }
+            }
+            if (nin) {
+                for (int k = 0; k < 3; k++) {
+                    nout[m].val[k] = nin[prev].val[k] +
+                                     t * (nin[i].val[k] - nin[prev].val[k]);
+                }
+            }
+            m++;
+        }
+
+        if (d >= 0.0) {
+            vout[m] = vin[i];
+            if (cin) {
+                cout[m] = cin[i];
+            }
+            if (nin) {
+                nout[m] = nin[i];
+            }
+            m++;
+        }
+
+        prev = i;
+        dPrev = d;
+    }
+
+    return m;
+}
+
+/**
+ * Clip the polygon, in homogeneous screen coordinates (i.e. transformed by
+ * the VTM but not yet normalized), against the clip volume cv. Colors and
+ * normals are interpolated along with the vertices. Returns the number of
+ * vertices left, which is 0 when the polygon is entirely outside the volume.
+ * 
+ * Polygons whose vertices are all inside are accepted, and polygons whose
+ * vertices are all outside the same plane are rejected, straight from the
+ * vertex outcodes; only the rest are clipped, and then only against the
+ * planes some vertex lies outside of. The polygon must own its arrays, since
+ * they are replaced when clipping adds vertices.
+ */
+int polygon_clip(Polygon *p, ClipVolume *cv) {
+    if (!p || !cv) {
+        printf("polygon_clip(): passed NULL pointer.\n");
+        return 0;
+    }
+
+    int orCode = 0;
+    int andCode = CLIP_ALL;
+    for (int i = 0; i < p->nVertex; i++) {
+        int code = point_outcode(&p->vertex[i], cv);
+        orCode |= code;
+        andCode &= code;
+    }
+
+    if (!orCode) {
+        return p->nVertex;
+    }
+    if (andCode || p->nVertex < 3) {
+        p->nVertex = 0;
+        return 0;
+    }
+
+    // Each plane adds at most one vertex to a convex polygon
+    int max = p->nVertex + 6;
+    Point *vtx[2];
+    Color *col[2] = {NULL, NULL};
+    Vector *nrm[2] = {NULL, NULL};
+    vtx[0] = malloc(sizeof(Point) * max);
+    vtx[1] = malloc(sizeof(Point) * max);
+    if (p->color) {
+        col[0] = malloc(sizeof(Color) * max);
+        col[1] = malloc(sizeof(Color) * max);
+    }
+    if (p->normal) {
+        nrm[0] = malloc(sizeof(Vector) * max);
+        nrm[1] = malloc(sizeof(Vector) * max);
+    }
+    if (!vtx[0] || !vtx[1] || (p->color && (!col[0] || !col[1])) ||
+        (p->normal && (!nrm[0] || !nrm[1]))) {
+        printf("polygon_clip(): malloc() failed.\n");
+        for (int k = 0; k < 2; k++) {
+            free(vtx[k]);
+            free(col[k]);
+            free(nrm[k]);
+        }
+        return p->nVertex;
+    }
+
+    int n = p->nVertex;
+    Point *vin = p->vertex;
+    Color *cin = p->color;
+    Vector *nin = p->normal;
+    int out = 0;
+
+    for (int plane = CLIP_LEFT; plane <= CLIP_FAR && n >= 3; plane <<= 1) {
+        if (!(orCode & plane)) {
+            continue;
+        }
+        n = clipPlane(plane, cv, n, vin, cin, nin,
+                      vtx[out], col[out], nrm[out]);
+        vin = vtx[out];
+        cin = col[out];
+        nin = nrm[out];
+        out = !out;
+    }
+
+    // The last pass wrote to the buffer at !out; the other one is scratch
+    free(p->vertex);
+    free(p->color);
+    free(p->normal);
+    p->vertex = vtx[!out];
+    p->color = col[!out];
+    p->normal = nrm[!out];
+    free(vtx[out]);
+    free(col[out]);
+    free(nrm[out]);
+
+    p->nVertex = n >= 3 ? n : 0;
+    return p->nVertex;
+}
+
 /**
  * Draw the outline of the polygon using color c
  */
@@ -400,6 +686,11 @@ typedef struct tEdge {
 	int yStart, yEnd;            /* start row and end row */
     float xIntersect, dxPerScan; /* where the edge intersects the current scanline and how it changes in x */
 	float zIntersect, dzPerScan; /* Where the edge intersects the current scanline and how it changes in z */
+    /* The interpolated vertex attribute - the color for Gouraud shading, the
+    normal for Phong shading - divided by z where the edge intersects the
+    current scanline, and how it changes. Like 1/z, it varies linearly in
+    screen space, so dividing by 1/z later is perspective correct */
+    float aIntersect[3], daPerScan[3];
     struct tEdge *next;
 } Edge;
 
@@ -438,13 +729,14 @@ static int compXIntersect( const void *a, const void *b ) {
 	Allocates, creates, fills out, and returns an Edge structure given
 	the inputs.
 
-	Current inputs are just the start and end location in image space.
-	Eventually, the points will be 3D and we'll add color and texture
-	coordinates.
+	Current inputs are the start and end location in image space and the
+	vertex attributes there, which are only interpolated when interp is set.
  */
-static Edge *makeEdgeRec( Point start, Point end, Image *src) {
+static Edge *makeEdgeRec( Point start, Point end, const float *aStart,
+                          const float *aEnd, int interp, Image *src) {
 	// float dscan = end.val[1] - start.val[1];
 	Point temp;
+	const float *atemp;
 
 	/******
 				 Your code starts here
@@ -454,6 +746,9 @@ static Edge *makeEdgeRec( Point start, Point end, Image *src) {
 		temp = start;
 		start = end;
 		end = temp;
+		atemp = aStart;
+		aStart = aEnd;
+		aEnd = atemp;
 	}
 
 	// Check if the starting row is below the image or the end row is
@@ -501,6 +796,15 @@ static Edge *makeEdgeRec( Point start, Point end, Image *src) {
 					   edge->dxPerScan * ((edge->yStart + 0.5) - edge->y0);
     edge->zIntersect = (1 / edge->z0) +
                        edge->dzPerScan * ((edge->yStart + 0.5) - edge->y0);
+    if (interp) {
+        for (int k = 0; k < 3; k++) {
+            float a0 = aStart[k] / start.val[2];
+            float a1 = aEnd[k] / end.val[2];
+            edge->daPerScan[k] = (a1 - a0) / (edge->y1 - edge->y0);
+            edge->aIntersect[k] = a0 + edge->daPerScan[k] *
+                                  ((edge->yStart + 0.5) - edge->y0);
+        }
+    }
 
 	// adjust if the edge starts above the image
 	// move the intersections down to scanline zero
@@ -515,6 +819,12 @@ static Edge *makeEdgeRec( Point start, Point end, Image *src) {
 		aligned to the tops/bottoms of pixels, so we adjust accordingly */
 		edge->xIntersect = edge->x0 + (edge->dxPerScan) * (-(edge->y0) + 0.5);
         edge->zIntersect = 1 / edge->z0 + (edge->dzPerScan) * (-(edge->y0) + 0.5);
+        if (interp) {
+            for (int k = 0; k < 3; k++) {
+                edge->aIntersect[k] = aStart[k] / start.val[2] +
+                                      edge->daPerScan[k] * (-(edge->y0) + 0.5);
+            }
+        }
 		edge->x0 = edge->x0 + (edge->dxPerScan) * (-(edge->y0));
         edge->z0 = edge->z0 + (edge->dzPerScan) * (-(edge->y0));
 		edge->y0 = 0; // y0 is 0
@@ -538,34 +848,63 @@ static Edge *makeEdgeRec( Point start, Point end, Image *src) {
 }
 
 
+/*
+	Put the attribute of vertex i that the shade method interpolates in a:
+	its color for Gouraud shading, its unit normal for Phong shading.
+ */
+static void vertexAttribute(Polygon *p, int i, DrawState *ds, float *a) {
+	if (ds->shade == ShadePhong) {
+		double len = p->normal ? sqrt(p->normal[i].val[0]*p->normal[i].val[0] +
+		                              p->normal[i].val[1]*p->normal[i].val[1] +
+		                              p->normal[i].val[2]*p->normal[i].val[2])
+		                       : 0.0;
+		for (int k = 0; k < 3; k++) {
+			a[k] = len > 0.0 ? p->normal[i].val[k] / len : 0.0;
+		}
+		return;
+	}
+
+	for (int k = 0; k < 3; k++) {
+		a[k] = p->color ? p->color[i].c[k] : ds->color.c[k];
+	}
+}
+
 /*
 	Returns a list of all the edges in the polygon in sorted order by
 	smallest row.
 */
-static LinkedList *setupEdgeList( Polygon *p, Image *src) {
+static LinkedList *setupEdgeList( Polygon *p, Image *src, DrawState *ds) {
 	LinkedList *edges = NULL;
 	Point v1, v2;
+	float a1[3] = {0.0, 0.0, 0.0}, a2[3] = {0.0, 0.0, 0.0};
 	int i;
+	int interp = ds->shade == ShadeGouraud || ds->shade == ShadePhong;
 
 	// create a linked list
 	edges = ll_new();
 
 	// walk around the polygon, starting with the last point
 	v1 = p->vertex[p->nVertex-1];
+	if (interp) {
+		vertexAttribute(p, p->nVertex-1, ds, a1);
+	}
 
 	for(i=0;i<p->nVertex;i++) {
 		
 		// the current point (i) is the end of the segment
 		v2 = p->vertex[i];
+		if (interp) {
+			vertexAttribute(p, i, ds, a2);
+		}
 
 		// if it is not a horizontal line
 		if( (int)(v1.val[1]+0.5) != (int)(v2.val[1]+0.5) ) {
 			Edge *edge;
 			// if the first coordinate is smaller (top edge)
 			if( v1.val[1] < v2.val[1] ){
-				edge = makeEdgeRec( v1, v2, src );
+				edge = makeEdgeRec( v1, v2, a1, a2, interp, src );
             } else {
-				edge = makeEdgeRec( v2, v1, src );
+				edge = makeEdgeRec( v2, v1, a2, a1, interp, src );
             }
 			// insert the edge into the list of edges if it's not null
 			if( edge ) {
@@ -573,6 +912,9 @@ static LinkedList *setupEdgeList( Polygon *p, Image *src) {
             }
 		}
 		v1 = v2;
+		a1[0] = a2[0];
+		a1[1] = a2[1];
+		a1[2] = a2[2];
 	}
 
 	// check for empty edges (like nothing in the viewport)
@@ -583,11 +925,51 @@ static LinkedList *setupEdgeList( Polygon *p, Image *src) {
 	return(edges);
 }
 
+/*
+	The span kernel for constant and flat shading: fill columns i up to f of
+	the scanline with c wherever the polygon, whose 1/z is curZ at column i,
+	is in front. With one color for the whole span the only work per pixel
+	is the depth test.
+ */
+static void fillSpanConstant(Image *src, int scan, int i, int f, float curZ,
+                             float dzPerColumn, Color c) {
+	float *depth = &src->depth[scan * src->cols];
+	FPixel *row = &src->data[scan * src->cols];
+
+	for (; i < f; i++) {
+		if (curZ > depth[i] && (curZ - depth[i] >= 0.03)) {
+			row[i].rgb[0] = c.c[0];
+			row[i].rgb[1] = c.c[1];
+			row[i].rgb[2] = c.c[2];
+			depth[i] = curZ;
+		}
+		curZ = curZ + dzPerColumn;
+	}
+}
+
+/*
+	Write one span of a polygon into the z-buffer alone, for depth-only
+	passes such as shadow maps. No color is read or written.
+ */
+static void fillSpanDepth(Image *src, int scan, int i, int f, float curZ,
+                          float dzPerColumn) {
+	float *depth = &src->depth[scan * src->cols];
+
+	for (; i < f; i++) {
+		if (curZ > depth[i] && (curZ - depth[i] >= 0.03)) {
+			depth[i] = curZ;
+		}
+		curZ = curZ + dzPerColumn;
+	}
+}
+
 /*
 	Draw one scanline of a polygon given the scanline, the active edges,
-	a DrawState, the image, and some Lights (for Phong shading only).
+	a DrawState, and the image. For Phong shading with a G-buffer, nothing is
+	colored; the normal and the material id are recorded instead.
  */
-static void fillScan(int scan, LinkedList *active, Image *src, Color c, DrawState* ds) {
+static void fillScan(int scan, LinkedList *active, Image *src, Color c,
+                     DrawState* ds, int material) {
   Edge *p1, *p2;
   int i, f;
 
@@ -611,6 +993,16 @@ static void fillScan(int scan, LinkedList *active, Image *src, Color c, DrawStat
 		/**** Your code goes here ****/
       float curZ = p1->zIntersect;
       float dzPerColumn = (p2->zIntersect - p1->zIntersect) / (p2->xIntersect - p1->xIntersect);
+      int interp = ds->shade == ShadeGouraud || ds->shade == ShadePhong;
+      float curA[3], daPerColumn[3]; // attribute/z along the span
+
+      if (interp) {
+          for (int k = 0; k < 3; k++) {
+              curA[k] = p1->aIntersect[k];
+              daPerColumn[k] = (p2->aIntersect[k] - p1->aIntersect[k]) /
+                               (p2->xIntersect - p1->xIntersect);
+          }
+      }
 
 	  // identify the starting column
 	  i = floor(p1->xIntersect);
@@ -618,6 +1010,11 @@ static void fillScan(int scan, LinkedList *active, Image *src, Color c, DrawStat
 	  // clip to the left side of the image
 	  if (i < 0) {
           curZ = curZ - i * dzPerColumn; // adjust curZ to 0th column val
+          if (interp) {
+              for (int k = 0; k < 3; k++) {
+                  curA[k] = curA[k] - i * daPerColumn[k];
+              }
+          }
 		  i = 0;
 	  }
 
@@ -628,12 +1025,42 @@ static void fillScan(int scan, LinkedList *active, Image *src, Color c, DrawStat
 		  f = (src->cols);
 	  }
 
+	  // Constant and flat shaded polygons have one color per polygon
+	  if (ds->shade == ShadeConstant || ds->shade == ShadeFlat) {
+		  fillSpanConstant(src, scan, i, f, curZ, dzPerColumn, c);
+		  p1 = ll_next( active );
+		  continue;
+	  }
+	  if (ds->shade == ShadeDepthOnly) {
+		  fillSpanDepth(src, scan, i, f, curZ, dzPerColumn);
+		  p1 = ll_next( active );
+		  continue;
+	  }
+
 	  // loop from start to end and color in the pixels
 	  while (i < f) {
           if (curZ > image_getz(src, scan, i) && (curZ - image_getz(src, scan, i) >= 0.03)) {
               switch (ds->shade) {
-                  case ShadeConstant:
-                    image_setColor(src, scan, i, c);
+                  case ShadeGouraud: ;
+                    // Recover the color from color/z
+                    float w = 1 / curZ;
+                    Color smooth;
+                    color_set(&smooth, curA[0] * w, curA[1] * w, curA[2] * w);
+                    image_setColor(src, scan, i, smooth);
+                    break;
+
+                  case ShadePhong:
+                    // Lit later, and only if nothing covers it by then
+                    if (material >= 0) {
+                        int index = scan * src->cols + i;
+                        float *n = &src->normal[index * 3];
+                        n[0] = curA[0] / curZ;
+                        n[1] = curA[1] / curZ;
+                        n[2] = curA[2] / curZ;
+                        src->material[index] = material;
+                    } else {
+                        image_setColor(src, scan, i, c);
+                    }
                     break;
 
                   case ShadeDepth:;
@@ -652,6 +1079,11 @@ static void fillScan(int scan, LinkedList *active, Image *src, Color c, DrawStat
           }
 		  i++;
           curZ = curZ + dzPerColumn;
+          if (interp) {
+              curA[0] += daPerColumn[0];
+              curA[1] += daPerColumn[1];
+              curA[2] += daPerColumn[2];
+          }
 	  }
 
 	  // move ahead to the next pair of edges
@@ -664,7 +1096,8 @@ static void fillScan(int scan, LinkedList *active, Image *src, Color c, DrawStat
 /* 
 	 Process the edge list, assumes the edges list has at least one entry
 */
-static int processEdgeList( LinkedList *edges, Image *src, Color c, DrawState* ds) {
+static int processEdgeList( LinkedList *edges, Image *src, Color c,
+                            DrawState* ds, int material) {
 	LinkedList *active = NULL;
 	LinkedList *tmplist = NULL;
 	LinkedList *transfer = NULL;
@@ -694,7 +1127,7 @@ static int processEdgeList( LinkedList *edges, Image *src, Color c, DrawState* d
 
 		// if there are active edges
 		// fill out the scanline
-		fillScan( scan, active, src, c, ds);
+		fillScan( scan, active, src, c, ds, material);
 
 		// remove any ending edges and update the rest
 		for(tedge = ll_pop(active); tedge != NULL; tedge = ll_pop(active)) {
@@ -706,6 +1139,11 @@ static int processEdgeList( LinkedList *edges, Image *src, Color c, DrawState* d
 				// update the edge information with the dPerScan values
 				tedge->xIntersect += tedge->dxPerScan;
                 tedge->zIntersect += tedge->dzPerScan;
+                if (ds->shade == ShadeGouraud || ds->shade == ShadePhong) {
+                    tedge->aIntersect[0] += tedge->daPerScan[0];
+                    tedge->aIntersect[1] += tedge->daPerScan[1];
+                    tedge->aIntersect[2] += tedge->daPerScan[2];
+                }
 
 				// adjust in the case of partial overlap
 				if( tedge->dxPerScan < 0.0 && tedge->xIntersect < tedge->x1 ) {
@@ -735,23 +1173,30 @@ static int processEdgeList( LinkedList *edges, Image *src, Color c, DrawState* d
 
 /**
  * Draw the filled polygon using color c with the scanline z-buffer rendering 
- * algorithm.
+ * algorithm. With ShadePhong, a polygon drawn into an image with a G-buffer
+ * leaves its interpolated normals and the DrawState's material there for
+ * lighting_shadeGBuffer(); without a G-buffer it is filled with c.
  */
 void polygon_drawFill(Polygon *p, Image *src, Color c, DrawState* ds) {
 	LinkedList *edges = NULL;
+	int material = -1;
 
     if (ds->shade == ShadeFrame) {
         polygon_draw(p, src, c);
         return;
     }
+    if (ds->shade == ShadePhong && src->material) {
+        material = image_material(src, &ds->body, &ds->surface,
+                                  ds->surfaceCoeff, p->oneSided);
+    }
 
 	// set up the edge list
-	edges = setupEdgeList(p, src);
+	edges = setupEdgeList(p, src, ds);
 	if(!edges)
 		return;
 	
 	// process the edge list (should be able to take an arbitrary edge list)
-	processEdgeList(edges, src, c, ds);
+	processEdgeList(edges, src, c, ds, material);
 
 	// clean up
 	ll_delete( edges, (void (*)(const void *))free );
@@ -135,6 +135,84 @@ void matrix_setView3D(Matrix *vtm, View3D *view) {
     // VTM is now a linear map from WORLD -> SCREEN
 }
 
+/**
+ * Set the DrawState's clip range to the front and back planes of the view, so
+ * module_draw() clips polygons against the whole view volume of the VTM built
+ * by matrix_setView3D(). That VTM leaves each point's homogeneous coordinate
+ * equal to its distance from the COP divided by d, which puts the front plane
+ * at (d + f) / d and the back plane at (d + b) / d.
+ */
+void view3D_setClip(View3D *view, DrawState *ds) {
+    if (!view || !ds) {
+        printf("view3D_setClip(): passed NULL pointer.\n");
+        return;
+    }
+
+    drawstate_setClip(ds, (view->d + view->f) / view->d,
+                      (view->d + view->b) / view->d);
+}
+
+/**
+ * Build the pipeline for a perspective View3D: the VTM from
+ * matrix_setView3D(), the clip range from view3D_setClip(), and the world
+ * coordinate frustum planes. A world point P lands inside the view volume
+ * when its screen coordinates satisfy 0 <= x <= screenx*h, 0 <= y <=
+ * screeny*h and near <= h <= far, and each of those is a linear function of
+ * P given by rows of the VTM.
+ */
+void viewpipeline_set(ViewPipeline *vp, View3D *view) {
+    if (!vp || !view) {
+        printf("viewpipeline_set(): passed NULL pointer.\n");
+        return;
+    }
+
+    vp->view = *view;
+    matrix_setView3D(&vp->vtm, view);
+    vp->clipNear = (view->d + view->f) / view->d;
+    vp->clipFar = (view->d + view->b) / view->d;
+
+    for (int k = 0; k < 4; k++) {
+        double x = vp->vtm.m[0][k];
+        double y = vp->vtm.m[1][k];
+        double h = vp->vtm.m[3][k];
+
+        vp->plane[0][k] = x; // left
+        vp->plane[1][k] = view->screenx * h - x; // right
+        vp->plane[2][k] = y; // top
+        vp->plane[3][k] = view->screeny * h - y; // bottom
+        vp->plane[4][k] = h; // front
+        vp->plane[5][k] = -h; // back
+    }
+    vp->plane[4][3] -= vp->clipNear;
+    vp->plane[5][3] += vp->clipFar;
+}
+
+/**
+ * Return 0 if the world coordinate box [min, max] lies entirely outside one
+ * of the pipeline's frustum planes, 1 if it may be visible. Each plane is
+ * tested against the corner of the box furthest along its normal.
+ */
+int viewpipeline_visible(ViewPipeline *vp, Point *min, Point *max) {
+    if (!vp || !min || !max) {
+        printf("viewpipeline_visible(): passed NULL pointer.\n");
+        return 0;
+    }
+
+    for (int i = 0; i < 6; i++) {
+        double *pl = vp->plane[i];
+        double dist = pl[3];
+
+        for (int k = 0; k < 3; k++) {
+            dist += pl[k] * (pl[k] > 0.0 ? max->val[k] : min->val[k]);
+        }
+        if (dist < 0.0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 /**
  * Create a VTM for parallel projections, treating VPN as the DOP.
  * 
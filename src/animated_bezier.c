@@ -25,6 +25,8 @@ int main(int argc, char *argv[]) {
 	color_set(&blue, .1, .2, .8);
 	
     printf("Setting bezier curve\n");
+	bezierCurve_init(&bc);
+	bezierCurve_zBuffer(&bc, 0); // 2D curve, no depth values
 	bezierCurve_set(&bc, p);
 
 	// set and draw the curve
@@ -0,0 +1,93 @@
+/**
+ * fractaltest.c
+ *
+ * David J. Anderson - November 2021
+ *
+ * Checks the subdivision (Mariani-Silver) fractal engine against brute force.
+ * Each view is rendered with both engines through image_mandelbrot() and
+ * image_julia(), and the two images are compared pixel by pixel. The number
+ * of differing pixels and the time taken by each engine are printed, and the
+ * program exits with status 1 if any view differs by more than 0.1% of its
+ * pixels. The subdivision output for each view is written to
+ * fractaltest-<n>.ppm.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "graphicslib.h"
+
+#define MAX_DIFF_FRACTION 0.001 // Largest tolerated fraction of differing pixels
+
+typedef struct {
+    int julia; // 1 for the Julia set, 0 for the Mandelbrot set
+    float x0, y0, x1, y1;
+    int rows;
+} View;
+
+static double seconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static Image *render(View *v, FractalEngine engine, double *elapsed) {
+    Image *im;
+    double start = seconds();
+
+    fractal_setEngine(engine);
+    if (v->julia) {
+        im = image_julia(v->x0, v->y0, v->x1, v->y1, v->rows);
+    } else {
+        im = image_mandelbrot(v->x0, v->y0, v->x1, v->y1, v->rows);
+    }
+    *elapsed = seconds() - start;
+
+    return im;
+}
+
+int main(int argc, char *argv[]) {
+    View views[] = {
+        {0, -2.0, -1.0, 0.6, 1.0, 600}, // whole set (mirrored: z^2 - c)
+        {0, 0.70, 0.05, 0.80, 0.15, 500}, // seahorse valley
+        {0, 1.74, -0.02, 1.78, 0.02, 500}, // tip of the needle
+        {1, -1.8, -1.2, 1.8, 1.2, 400}, // whole Julia set
+        {1, -0.3, -0.3, 0.3, 0.3, 400} // Julia set detail
+    };
+    int nViews = sizeof(views) / sizeof(View);
+    int failed = 0;
+    char filename[64];
+
+    for (int v = 0; v < nViews; v++) {
+        double tBrute, tSub;
+        Image *brute = render(&views[v], EngineBrute, &tBrute);
+        Image *sub = render(&views[v], EngineSubdivide, &tSub);
+        int pixels = brute->rows * brute->cols;
+        int diff = 0;
+
+        for (int i = 0; i < pixels; i++) {
+            if (memcmp(&brute->data[i], &sub->data[i], sizeof(FPixel))) {
+                diff++;
+            }
+        }
+
+        printf("%s view %d (%dx%d): brute %.3fs, subdivide %.3fs, "
+               "%d pixels differ\n", views[v].julia ? "julia" : "mandelbrot",
+               v, brute->cols, brute->rows, tBrute, tSub, diff);
+        if (diff > MAX_DIFF_FRACTION * pixels) {
+            printf("  FAILED: more than %.1f%% of pixels differ\n",
+                   MAX_DIFF_FRACTION * 100);
+            failed = 1;
+        }
+
+        sprintf(filename, "fractaltest-%d.ppm", v);
+        image_write(sub, filename);
+        image_free(brute);
+        image_free(sub);
+    }
+
+    fractal_setEngine(EngineBrute);
+    printf(failed ? "fractaltest: FAILED\n" : "fractaltest: passed\n");
+
+    return failed;
+}
@@ -3,40 +3,52 @@
  * 
  * David Anderson, fall 2021
  * 
- * Work in progress. This is a simple program to render the Henon
- * attractor that I wrote while reading up on chaotic systems. it is
- * not currently designed to be flexible enough for generalized use.
+ * Renders a density plot of the Henon attractor, (x, y) -> (y - a x^2 + 1,
+ * b x) with the classic a = 1.4 and b = 0.3, to henon.ppm. Orbits are
+ * iterated in parallel on every CPU and the hit counts tone mapped on a log
+ * scale, so even faint folds of the attractor show up.
+ *
+ * Usage: henon [points [rows]] (defaults 100000000 and 900).
  */
 
 #include <math.h>
 #include <stdio.h>
-#include "../include/image.h"
+#include <stdlib.h>
+#include <time.h>
+#include "graphicslib.h"
 
 int main(int argc, char *argv[]) {
-    int rows = 250;
-    int cols = 600;
-    double a, b, x, y, xPrime, yPrime;
-    int t;
-    Image *image = image_create(rows, cols);
-
-    a = 7.0/5.0;
-    b = 3.0/10.0;
-
-    x = 0.0;
-    y = 0.0;
+    long long points = argc > 1 ? atoll(argv[1]) : 100000000LL;
+    int rows = argc > 2 ? atoi(argv[2]) : 900;
+    int cols = rows * 10 / 3;
+    double a = 7.0/5.0;
+    double b = 3.0/10.0;
+    Color color;
+    Attractor *at;
+    Image *image;
+    clock_t start;
 
+    if (points <= 0 || rows <= 0) {
+        printf("usage: %s [points [rows]]\n", argv[0]);
+        return 1;
+    }
 
-    for (t = 0; t < 100000; t++) {
-        printf("t = %d, x = %f, y = %f\n", t, x, y);
-        image_setc(image, (125 - (int) (y * 100)), ((int) (x * 100)) + 300, 0, 
-            image_getc(image, (125 - (int) (y * 100)), ((int) (x * 100)) + 300, 0) + 0.005);
-        xPrime = y - a * x * x + 1;
-        yPrime = b * x;
-        x = xPrime;
-        y = yPrime;
+    at = attractor_create(rows, cols, -1.5, -0.45, 1.5, 0.45);
+    image = image_create(rows, cols);
+    if (!at || !image) {
+        return 1;
     }
 
+    start = clock();
+    attractor_henon(at, a, b, points, 1);
+    printf("Plotted %lld points in %.2f s of CPU time.\n", points,
+           (double) (clock() - start) / CLOCKS_PER_SEC);
+
+    color_set(&color, 1.0, 0.85, 0.6);
+    attractor_toImage(at, image, &color);
     image_write(image, "henon.ppm");
+
     image_free(image);
-    return 1;
-}
\ No newline at end of file
+    attractor_free(at);
+    return 0;
+}
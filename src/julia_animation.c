@@ -0,0 +1,47 @@
+/**
+ * julia_animation.c
+ *
+ * David Anderson, November 2021
+ *
+ * Renders an animation of Julia sets as c travels once around the circle
+ * |c| = 0.7885, writing the frames to julia-000.ppm, julia-001.ppm, ... in
+ * the current directory. They can be joined into a movie with, for example,
+ * "convert -delay 5 julia-*.ppm julia.gif".
+ *
+ * Usage: julia_animation [frames [rows]] (defaults 60 and 300).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "graphicslib.h"
+
+int main(int argc, char *argv[]) {
+    int frames = argc > 1 ? atoi(argv[1]) : 60;
+    int rows = argc > 2 ? atoi(argv[2]) : 300;
+    int cols = rows * 3 / 2;
+    double *cx, *cy;
+
+    if (frames <= 0 || rows <= 0) {
+        printf("usage: %s [frames [rows]]\n", argv[0]);
+        return 1;
+    }
+
+    cx = malloc(sizeof(double) * frames);
+    cy = malloc(sizeof(double) * frames);
+    if (!cx || !cy) {
+        printf("julia_animation: malloc() failed.\n");
+        return 1;
+    }
+    for (int k = 0; k < frames; k++) {
+        double angle = 2 * M_PI * k / frames;
+        cx[k] = 0.7885 * cos(angle);
+        cy[k] = 0.7885 * sin(angle);
+    }
+
+    int done = julia_animate(frames, cx, cy, rows, cols, -1.8, -1.2, 3.6,
+                             julia_frameWriter, "julia-%03d.ppm");
+    printf("Wrote %d frames.\n", done);
+
+    free(cx);
+    free(cy);
+    return done == frames ? 0 : 1;
+}
@@ -8,18 +8,73 @@
  * then calls the functions defined in mandelbrot.h to output the image to the
  * file "mandelbrot_main_output.ppm" in whichever directory the program is being
  * run.
+ *
+ * Rows are rendered in parallel on every CPU by default; pass a thread count as
+ * the only argument (e.g. "mandelbrot_interactive 4") to use a different number.
+ *
+ * Images are rendered progressively on a background thread: the output file is
+ * rewritten after every pass, starting from a coarse preview, and entering a
+ * new rectangle cancels a render that is still running so the new one starts
+ * straight away.
  */
 
 
 #include <stdio.h>
-#include "image.h"
-#include "mandelbrot.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include "graphicslib.h"
+
+#define OUTPUT "mandelbrot_main_output.ppm"
+
+/* A render running on its own thread */
+typedef struct {
+    pthread_t thread;
+    int running; // whether thread has been started and not yet joined
+    FractalCancel cancel;
+    int rows;
+    float x0, y0, x1, y1;
+} Render;
+
+/**
+ * Write each pass of the render to the output file as it finishes.
+ */
+static void writePass(Image *im, int step, void *arg) {
+    image_write(im, OUTPUT);
+    if (step == 1) {
+        printf("Wrote %s.\n", OUTPUT);
+    }
+}
+
+static void *renderThread(void *arg) {
+    Render *r = arg;
+    Image *im = image_mandelbrotProgressive(r->x0, r->y0, r->x1, r->y1, r->rows,
+                                  writePass, NULL, &r->cancel);
+    image_free(im);
+    return NULL;
+}
+
+/**
+ * Cancel the render if it is still running and wait for its thread to exit.
+ */
+static void stopRender(Render *r) {
+    if (r->running) {
+        fractal_cancel(&r->cancel);
+        pthread_join(r->thread, NULL);
+        r->running = 0;
+    }
+}
 
 int main(int argc, char *argv[]) {
     /* For storing rows and dimensions of the complex rect, the user input */
     int rows;
     float x0, y0, x1, y1;
+    Render render = {.running = 0};
     
+    /* optional thread count */
+    if (argc > 1) {
+        parallel_setThreads(atoi(argv[1]));
+    }
+
     /* startup message */
     printf("Now running mandelbrot. Press Ctl-C to quit.\n");
     
@@ -31,6 +86,9 @@ int main(int argc, char *argv[]) {
         
         /* Read in a line of user input */
         int result = scanf("%d%f%f%f%f", &rows, &x0, &y0, &x1, &y1);
+        if (result == EOF) {
+            break;
+        }
         
         /* Check case where input is not valid*/
         if (rows <= 0 || result < 5 || (x1 - x0) <= 0.0 || (y1 - y0) <= 0) {
@@ -46,11 +104,22 @@ int main(int argc, char *argv[]) {
                 ; // Read until newline
             }
         } else {
-            /* Create an image with the specs given by the user */
-            Image *toReturn = image_mandelbrot(x0, y0, x1, y1, rows);
-            image_write(toReturn, "mandelbrot_main_output.ppm");
-            image_free(toReturn);
+            /* Abandon the previous image and render the new one */
+            stopRender(&render);
+            fractal_cancelInit(&render.cancel);
+            render.rows = rows;
+            render.x0 = x0;
+            render.y0 = y0;
+            render.x1 = x1;
+            render.y1 = y1;
+            render.running = pthread_create(&render.thread, NULL, renderThread,
+                                            &render) == 0;
         }
     }
+
+    /* Let the last render finish at end of input */
+    if (render.running) {
+        pthread_join(render.thread, NULL);
+    }
     return 0;
 }
\ No newline at end of file
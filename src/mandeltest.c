@@ -6,9 +6,7 @@
 
   Includes updated by David Anderson September 2021
 */
-#include "image.h"
-#include "mandelbrot.h"
-#include "julia.h"
+#include "graphicslib.h"
 
 int main(int argc, char *argv[]) {
   Image *src;
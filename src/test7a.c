@@ -24,6 +24,8 @@ int main(int argc, char *argv[]) {
 
 	// set and draw the curve
 	printf("Setting bezier curve\n");
+	bezierCurve_init(&bc);
+	bezierCurve_zBuffer(&bc, 0); // 2D curve, no depth values
 	bezierCurve_set(&bc, p);
 
 	printf("Drawing bezier curve\n");
@@ -0,0 +1,109 @@
+/**
+ * test9a.c
+ *
+ * David J. Anderson - November 2021
+ *
+ * Draws a lit scene - a teapot sitting on a block - with flat, Gouraud, and
+ * Phong shading. The scene is lit by an ambient light, a directional light
+ * passed to module_draw(), and a point light placed in the scene itself.
+ * Writes test9a-flat.ppm, test9a-gouraud.ppm, and test9a-phong.ppm.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "graphicslib.h"
+
+int main(int argc, char *argv[]) {
+    Image *src;
+    Matrix VTM, GTM;
+    Module *scene, *teapot, *pot;
+    DrawState *ds;
+    View3D view;
+    Lighting *lighting;
+    Light light;
+    Point lightPos;
+    Vector lightDir;
+    int rows = 360;
+    int cols = 480;
+
+    Color white = {{1.0, 1.0, 1.0}};
+    Color dim = {{0.2, 0.2, 0.2}};
+    Color warm = {{0.6, 0.5, 0.4}};
+    Color red = {{0.8, 0.2, 0.15}};
+    Color slate = {{0.3, 0.35, 0.45}};
+    Color shine = {{0.5, 0.5, 0.5}};
+
+    // set the View parameters
+    point_set3D(&(view.vrp), 0.0, 2.0, -8.0);
+    vector_set(&(view.vpn), 0.0, -0.25, 1.0);
+    vector_set(&(view.vup), 0.0, 1.0, 0.0);
+    view.d = 2.0;
+    view.du = 1.6;
+    view.dv = 1.2;
+    view.f = 0.0;
+    view.b = 20;
+    view.screenx = cols;
+    view.screeny = rows;
+    matrix_setView3D(&VTM, &view);
+
+    // module_teapot() adds its own matrices, so it gets a module of its own
+    pot = module_create();
+    module_teapot(pot, 3);
+
+    teapot = module_create();
+    module_bodyColor(teapot, &red);
+    module_surfaceColor(teapot, &shine);
+    module_surfaceCoeff(teapot, 20);
+    module_translate(teapot, 0.0, -0.15, 0.0); // rest the base on y = 0
+    module_scale(teapot, 0.6, 0.6, 0.6);
+    module_module(teapot, pot);
+
+    scene = module_create();
+    point_set3D(&lightPos, -4.0, 5.0, -4.0);
+    light_set(&light, LightPoint, &warm, NULL, &lightPos);
+    module_light(scene, &light);
+
+    module_bodyColor(scene, &slate);
+    module_surfaceColor(scene, &dim);
+    module_surfaceCoeff(scene, 5);
+    module_scale(scene, 2.5, 0.5, 2.5);
+    module_translate(scene, 0.0, -0.5, 0.0);
+    module_cube(scene, 1);
+    module_identity(scene);
+    module_module(scene, teapot);
+
+    lighting = lighting_create();
+    light_set(&light, LightAmbient, &dim, NULL, NULL);
+    lighting_add(lighting, &light);
+    vector_set(&lightDir, 1.0, -1.0, 1.0);
+    light_set(&light, LightDirect, &white, &lightDir, NULL);
+    lighting_add(lighting, &light);
+
+    ds = drawstate_create();
+    point_copy(&(ds->viewer), &(view.vrp));
+    view3D_setClip(&view, ds);
+    matrix_identity(&GTM);
+
+    src = image_create(rows, cols);
+    ds->shade = ShadeFlat;
+    module_draw(scene, &VTM, &GTM, ds, lighting, src);
+    image_write(src, "test9a-flat.ppm");
+
+    image_reset(src);
+    ds->shade = ShadeGouraud;
+    module_draw(scene, &VTM, &GTM, ds, lighting, src);
+    image_write(src, "test9a-gouraud.ppm");
+
+    image_reset(src);
+    ds->shade = ShadePhong;
+    module_draw(scene, &VTM, &GTM, ds, lighting, src);
+    image_write(src, "test9a-phong.ppm");
+
+    image_free(src);
+    lighting_free(lighting);
+    free(ds);
+    module_delete(pot);
+    module_delete(teapot);
+    module_delete(scene);
+
+    return 0;
+}
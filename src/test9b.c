@@ -0,0 +1,138 @@
+/**
+ * test9b.c
+ *
+ * David J. Anderson - November 2021
+ *
+ * Draws the teapot on a block from test9a with a point light that casts
+ * shadows. The scene is first drawn from the light into a shadow map, depth
+ * only, then drawn from the camera with Gouraud and Phong shading.
+ * Writes test9b-shadowmap.ppm, test9b-gouraud.ppm, and test9b-phong.ppm.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "graphicslib.h"
+
+int main(int argc, char *argv[]) {
+    Image *src, *map;
+    Matrix VTM, GTM;
+    Module *scene, *teapot, *pot;
+    DrawState *ds;
+    View3D view, lightView;
+    ViewPipeline lightPipeline;
+    ShadowMap *shadow;
+    Lighting *lighting;
+    Light light;
+    Point lightPos;
+    float nearest = 0.0;
+    int rows = 360;
+    int cols = 480;
+
+    Color dim = {{0.2, 0.2, 0.2}};
+    Color warm = {{0.9, 0.8, 0.7}};
+    Color red = {{0.8, 0.2, 0.15}};
+    Color slate = {{0.3, 0.35, 0.45}};
+    Color shine = {{0.5, 0.5, 0.5}};
+
+    // set the View parameters
+    point_set3D(&(view.vrp), 0.0, 2.0, -8.0);
+    vector_set(&(view.vpn), 0.0, -0.25, 1.0);
+    vector_set(&(view.vup), 0.0, 1.0, 0.0);
+    view.d = 2.0;
+    view.du = 1.6;
+    view.dv = 1.2;
+    view.f = 0.0;
+    view.b = 20;
+    view.screenx = cols;
+    view.screeny = rows;
+    matrix_setView3D(&VTM, &view);
+
+    // the light looks at the middle of the block from above and to the left
+    point_set3D(&lightPos, -4.0, 5.0, -2.0);
+    lightView.vrp = lightPos;
+    vector_set(&(lightView.vpn), 4.0, -5.0, 2.0);
+    vector_set(&(lightView.vup), 0.0, 1.0, 0.0);
+    lightView.d = 1.0;
+    lightView.du = 1.0;
+    lightView.dv = 1.0;
+    lightView.f = 0.0;
+    lightView.b = 20;
+    lightView.screenx = 512;
+    lightView.screeny = 512;
+    viewpipeline_set(&lightPipeline, &lightView);
+    shadow = shadowmap_create(&lightPipeline);
+    if (!shadow) {
+        return -1;
+    }
+
+    // module_teapot() adds its own matrices, so it gets a module of its own
+    pot = module_create();
+    module_teapot(pot, 3);
+
+    teapot = module_create();
+    module_bodyColor(teapot, &red);
+    module_surfaceColor(teapot, &shine);
+    module_surfaceCoeff(teapot, 20);
+    module_translate(teapot, 0.0, -0.15, 0.0); // rest the base on y = 0
+    module_scale(teapot, 0.6, 0.6, 0.6);
+    module_module(teapot, pot);
+
+    scene = module_create();
+    light_set(&light, LightPoint, &warm, NULL, &lightPos);
+    light_setShadow(&light, shadow);
+    module_light(scene, &light);
+
+    module_bodyColor(scene, &slate);
+    module_surfaceColor(scene, &dim);
+    module_surfaceCoeff(scene, 5);
+    module_scale(scene, 2.5, 0.5, 2.5);
+    module_translate(scene, 0.0, -0.5, 0.0);
+    module_cube(scene, 1);
+    module_identity(scene);
+    module_module(scene, teapot);
+
+    lighting = lighting_create();
+    light_set(&light, LightAmbient, &dim, NULL, NULL);
+    lighting_add(lighting, &light);
+
+    matrix_identity(&GTM);
+    module_drawShadowMap(scene, &GTM, shadow);
+
+    // show the map in gray, brighter nearer the light
+    map = shadow->depth;
+    for (int i = 0; i < map->rows * map->cols; i++) {
+        nearest = map->depth[i] > nearest ? map->depth[i] : nearest;
+    }
+    for (int i = 0; i < map->rows; i++) {
+        for (int j = 0; j < map->cols; j++) {
+            float gray = image_getz(map, i, j) / nearest;
+            image_setc(map, i, j, 0, gray);
+            image_setc(map, i, j, 1, gray);
+            image_setc(map, i, j, 2, gray);
+        }
+    }
+    image_write(map, "test9b-shadowmap.ppm");
+
+    ds = drawstate_create();
+    point_copy(&(ds->viewer), &(view.vrp));
+    view3D_setClip(&view, ds);
+
+    src = image_create(rows, cols);
+    ds->shade = ShadeGouraud;
+    module_draw(scene, &VTM, &GTM, ds, lighting, src);
+    image_write(src, "test9b-gouraud.ppm");
+
+    image_reset(src);
+    ds->shade = ShadePhong;
+    module_draw(scene, &VTM, &GTM, ds, lighting, src);
+    image_write(src, "test9b-phong.ppm");
+
+    image_free(src);
+    shadowmap_free(shadow);
+    lighting_free(lighting);
+    free(ds);
+    module_delete(pot);
+    module_delete(teapot);
+    module_delete(scene);
+
+    return 0;
+}
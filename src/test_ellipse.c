@@ -0,0 +1,110 @@
+/*
+  David J. Anderson
+  Checks that rotated ellipse outlines are unbroken: for a range of angles and
+  aspect ratios, the pixels ellipse_draw() colors must form a single
+  8-connected component. Writes the last failing outline (or, if all pass, a
+  sample) to test_ellipse.ppm and returns 1 if any outline is broken.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "graphicslib.h"
+
+#define ROWS 300
+#define COLS 300
+
+/*
+  Count the 8-connected components of colored pixels in src, using stack as
+  scratch space for the flood fill.
+*/
+static int countComponents(Image *src, char *seen, int *stack) {
+  int components = 0;
+
+  for (int i = 0; i < ROWS * COLS; i++) {
+    seen[i] = src->data[i].rgb[0] == 0.0;
+  }
+
+  for (int start = 0; start < ROWS * COLS; start++) {
+    int top = 0;
+
+    if (seen[start]) {
+      continue;
+    }
+    components++;
+    seen[start] = 1;
+    stack[top++] = start;
+    while (top > 0) {
+      int p = stack[--top];
+      int r = p / COLS, c = p % COLS;
+
+      for (int dr = -1; dr <= 1; dr++) {
+        for (int dc = -1; dc <= 1; dc++) {
+          int nr = r + dr, nc = c + dc;
+          if (nr < 0 || nr >= ROWS || nc < 0 || nc >= COLS ||
+              seen[nr * COLS + nc]) {
+            continue;
+          }
+          seen[nr * COLS + nc] = 1;
+          stack[top++] = nr * COLS + nc;
+        }
+      }
+    }
+  }
+
+  return components;
+}
+
+int main(int argc, char *argv[]) {
+  double radii[][2] = {{80, 10}, {100, 60}, {120, 4}, {40, 38}, {60, 2}};
+  int nRadii = sizeof(radii) / sizeof(radii[0]);
+  char *seen = malloc(ROWS * COLS);
+  int *stack = malloc(sizeof(int) * ROWS * COLS);
+  Image *src = image_create(ROWS, COLS);
+  Color white = {{1.0, 1.0, 1.0}};
+  Ellipse e;
+  Point center;
+  int tested = 0, failed = 0;
+
+  if (!seen || !stack || !src) {
+    printf("test_ellipse: out of memory\n");
+    return 1;
+  }
+
+  point_set2D(&center, COLS / 2, ROWS / 2);
+  for (int k = 0; k < nRadii; k++) {
+    for (int step = 1; step < 36; step++) {
+      double angle = step * M_PI / 36.0;
+      int components;
+
+      image_reset(src);
+      ellipse_set(&e, center, radii[k][0], radii[k][1]);
+      ellipse_setAngle(&e, angle);
+      ellipse_draw(&e, src, white);
+
+      components = countComponents(src, seen, stack);
+      tested++;
+      if (components != 1) {
+        printf("%gx%g at %.3f rad: %d pieces\n", radii[k][0], radii[k][1],
+               angle, components);
+        image_write(src, "test_ellipse.ppm");
+        failed++;
+      }
+    }
+  }
+
+  if (!failed) {
+    image_reset(src);
+    ellipse_set(&e, center, 80, 10);
+    ellipse_setAngle(&e, 0.3);
+    ellipse_draw(&e, src, white);
+    image_write(src, "test_ellipse.ppm");
+  }
+  printf("%d of %d rotated outlines are 8-connected\n", tested - failed,
+         tested);
+
+  image_free(src);
+  free(seen);
+  free(stack);
+
+  return failed ? 1 : 0;
+}